@@ -1,7 +1,39 @@
 #pragma once
 #include <QMap>
+#include <QVector>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
 #include "intervaltreenode.h"
 
+/*
+вѯÿֻһдԼռbuffer˲Ҫ
+*/
+template <class Key, class T>
+class IntervalTreeSearchTask : public QRunnable
+{
+public:
+	const IntervalTreeNode<Key, T>* node;
+	Key begin;
+	Key end;
+	bool envelop;
+	QList<Interval<Key, T>>* buffer;
+	QSemaphore* done;
+
+public:
+	IntervalTreeSearchTask(const IntervalTreeNode<Key, T>* node, const Key& begin, const Key& end,
+		bool envelop, QList<Interval<Key, T>>* buffer, QSemaphore* done)
+		: node(node), begin(begin), end(end), envelop(envelop), buffer(buffer), done(done)
+	{
+	}
+
+	void run() override
+	{
+		this->node->search_range(this->begin, this->end, this->envelop, *this->buffer);
+		this->done->release();
+	}
+};
+
 template <class Key, class T>
 class IntervalTree
 {
@@ -42,6 +74,10 @@ public:
 	QSet<Interval<Key, T>> envelop(const Interval<Key, T>& begin) const;
 	QSet<Interval<Key, T>> overlap(const Key& begin, const Key& end) const;
 	QSet<Interval<Key, T>> overlap(const Interval<Key, T>& begin) const;
+	QSet<Interval<Key, T>> overlap_parallel(const Key& begin, const Key& end, QThreadPool* pool = nullptr) const;
+	QSet<Interval<Key, T>> envelop_parallel(const Key& begin, const Key& end, QThreadPool* pool = nullptr) const;
+	QSet<Interval<Key, T>> search_range_parallel(const Key& begin, const Key& end, bool envelop,
+		QThreadPool* pool) const;
 
 	Key begin() const;
 	Key end() const;
@@ -348,6 +384,88 @@ QSet<Interval<Key, T>> IntervalTree<Key, T>::overlap(const Interval<Key, T>& beg
 	return this->overlap(begin.begin, begin.end);
 }
 
+template <class Key, class T>
+QSet<Interval<Key, T>> IntervalTree<Key, T>::overlap_parallel(const Key& begin, const Key& end, QThreadPool* pool) const
+{
+	return this->search_range_parallel(begin, end, false, pool);
+}
+
+template <class Key, class T>
+QSet<Interval<Key, T>> IntervalTree<Key, T>::envelop_parallel(const Key& begin, const Key& end, QThreadPool* pool) const
+{
+	return this->search_range_parallel(begin, end, true, pool);
+}
+
+/*
+ڵ߳дtop_nodeչֱõ㹻໥ཻ(ÿ߳Լ4)
+չоĽڵֱڵ߳м飻Ȼÿ̳߳еһ
+ϲĽpoolΪʱʹQThreadPool::globalInstance()
+̻߳ȴ˲Ҫͬһ̳߳صе
+*/
+template <class Key, class T>
+QSet<Interval<Key, T>> IntervalTree<Key, T>::search_range_parallel(const Key& begin, const Key& end, bool envelop,
+	QThreadPool* pool) const
+{
+	QSet<Interval<Key, T>> result;
+	if (!this->top_node)
+	{
+		return result;
+	}
+	if (begin >= end)
+	{
+		return result;
+	}
+	if (!pool)
+	{
+		pool = QThreadPool::globalInstance();
+	}
+
+	QList<Interval<Key, T>> local;
+	QList<const IntervalTreeNode<Key, T>*> frontier;
+	frontier.append(this->top_node);
+	int target = std::max(1, pool->maxThreadCount()) * 4;
+	while (!frontier.isEmpty() && frontier.size() < target)
+	{
+		const IntervalTreeNode<Key, T>* node = frontier.takeFirst();
+		node->search_range_center(begin, end, envelop, local);
+		if (begin < node->x_center && node->left_node)
+		{
+			frontier.append(node->left_node);
+		}
+		if (end > node->x_center && node->right_node)
+		{
+			frontier.append(node->right_node);
+		}
+	}
+
+	QVector<QList<Interval<Key, T>>> buffers(frontier.size());
+	QSemaphore done;
+	for (int i = 0; i < frontier.size(); i++)
+	{
+		pool->start(new IntervalTreeSearchTask<Key, T>(frontier[i], begin, end, envelop, &buffers[i], &done));
+	}
+	done.acquire(frontier.size());
+
+	int total = local.size();
+	for (const auto& buffer : buffers)
+	{
+		total += buffer.size();
+	}
+	result.reserve(total);
+	for (const auto& iv : local)
+	{
+		result.insert(iv);
+	}
+	for (const auto& buffer : buffers)
+	{
+		for (const auto& iv : buffer)
+		{
+			result.insert(iv);
+		}
+	}
+	return result;
+}
+
 template <class Key, class T>
 Key IntervalTree<Key, T>::begin() const
 {
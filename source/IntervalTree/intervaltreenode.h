@@ -62,6 +62,8 @@ public:
 
 	QSet<Interval<Key, T>> search_overlap(const QList<Key>& point_list);
 	QSet<Interval<Key, T>> search_point(const Key& point, QSet<Interval<Key, T>>& result);
+	void search_range(const Key& begin, const Key& end, bool envelop, QList<Interval<Key, T>>& result) const;
+	void search_range_center(const Key& begin, const Key& end, bool envelop, QList<Interval<Key, T>>& result) const;
 	IntervalTreeNode* prune();
 	std::pair<IntervalTreeNode*, IntervalTreeNode*> pop_greatest_child();
 	bool contains_point(const Key& p);
@@ -365,6 +367,45 @@ QSet<Interval<Key, T>> IntervalTreeNode<Key, T>::search_point(const Key& point,
 	return result;
 }
 
+/*
+ѯ[begin, end)search_overlapĽһ£Ҫ߽search_point
+end <= x_centerbegin > x_centerݴ˼֦
+envelopΪtrueʱֻ[begin, end)
+*/
+template <class Key, class T>
+void IntervalTreeNode<Key, T>::search_range(const Key& begin, const Key& end, bool envelop,
+	QList<Interval<Key, T>>& result) const
+{
+	this->search_range_center(begin, end, envelop, result);
+	if (begin < this->x_center && this->left_node)
+	{
+		this->left_node->search_range(begin, end, envelop, result);
+	}
+	if (end > this->x_center && this->right_node)
+	{
+		this->right_node->search_range(begin, end, envelop, result);
+	}
+}
+
+template <class Key, class T>
+void IntervalTreeNode<Key, T>::search_range_center(const Key& begin, const Key& end, bool envelop,
+	QList<Interval<Key, T>>& result) const
+{
+	for (const auto& k : this->s_center)
+	{
+		// 䲻ᱻsearch_pointУͬ
+		if (!(k.begin < k.end) || !k.overlaps(begin, end))
+		{
+			continue;
+		}
+		if (envelop && !(k.begin >= begin && k.end <= end))
+		{
+			continue;
+		}
+		result.append(k);
+	}
+}
+
 template <class Key, class T>
 IntervalTreeNode<Key, T>* IntervalTreeNode<Key, T>::prune()
 {
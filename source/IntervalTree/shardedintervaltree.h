@@ -0,0 +1,329 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include "intervaltree.h"
+
+/*
+beginȡֵΧƬIntervalTree
+split_points = [p0, p1, ..., pn-1]keyռֳn+1Ƭ䰴beginĸƬţ
+ÿƬԼͬƬϵĲڶ߳ͬʱ
+*/
+template <class Key, class T>
+class ShardedIntervalTree
+{
+public:
+	struct Shard
+	{
+		IntervalTree<Key, T> tree;
+		mutable QMutex mutex;
+	};
+
+	QList<Key> split_points;
+	QVector<Shard*> shards;
+
+public:
+	ShardedIntervalTree(const QList<Key>& split_points);
+	~ShardedIntervalTree();
+
+	int shard_index(const Key& begin) const;
+	int size() const;
+
+	void add(const Interval<Key, T>& interval);
+	void addi(const Key& begin, const Key& end, const T& data);
+	template <typename Container>
+	void update(const Container& intervals);
+	template <typename Container>
+	void update_parallel(const Container& intervals, QThreadPool* pool = nullptr);
+	void remove(const Interval<Key, T>& interval);
+	void discard(const Interval<Key, T>& interval);
+	void clear();
+
+	QSet<Interval<Key, T>> at(const Key& p) const;
+	QSet<Interval<Key, T>> overlap(const Key& begin, const Key& end) const;
+	QSet<Interval<Key, T>> envelop(const Key& begin, const Key& end) const;
+	QSet<Interval<Key, T>> overlap_parallel(const Key& begin, const Key& end, QThreadPool* pool = nullptr) const;
+
+	bool shard_hit(int index, const Key& begin, const Key& end) const;
+	bool __contains__(const Interval<Key, T>& item) const;
+
+private:
+	ShardedIntervalTree(const ShardedIntervalTree&);
+	ShardedIntervalTree& operator=(const ShardedIntervalTree&);
+};
+
+class ShardedIntervalTreeTask : public QRunnable
+{
+public:
+	std::function<void()> func;
+	QSemaphore* done;
+
+public:
+	ShardedIntervalTreeTask(const std::function<void()>& func, QSemaphore* done)
+		: func(func), done(done)
+	{
+	}
+
+	void run() override
+	{
+		this->func();
+		this->done->release();
+	}
+};
+
+template <class Key, class T>
+ShardedIntervalTree<Key, T>::ShardedIntervalTree(const QList<Key>& split_points)
+{
+	this->split_points = split_points;
+	std::sort(this->split_points.begin(), this->split_points.end());
+	this->split_points.erase(std::unique(this->split_points.begin(), this->split_points.end()),
+		this->split_points.end());
+	for (int i = 0; i <= this->split_points.size(); i++)
+	{
+		this->shards.append(new Shard);
+	}
+}
+
+template <class Key, class T>
+ShardedIntervalTree<Key, T>::~ShardedIntervalTree()
+{
+	qDeleteAll(this->shards);
+}
+
+template <class Key, class T>
+int ShardedIntervalTree<Key, T>::shard_index(const Key& begin) const
+{
+	return std::upper_bound(this->split_points.begin(), this->split_points.end(), begin)
+		- this->split_points.begin();
+}
+
+template <class Key, class T>
+int ShardedIntervalTree<Key, T>::size() const
+{
+	int count = 0;
+	for (const Shard* shard : this->shards)
+	{
+		QMutexLocker locker(&shard->mutex);
+		count += shard->tree.all_intervals.size();
+	}
+	return count;
+}
+
+template <class Key, class T>
+void ShardedIntervalTree<Key, T>::add(const Interval<Key, T>& interval)
+{
+	Shard* shard = this->shards[this->shard_index(interval.begin)];
+	QMutexLocker locker(&shard->mutex);
+	shard->tree.add(interval);
+}
+
+template <class Key, class T>
+void ShardedIntervalTree<Key, T>::addi(const Key& begin, const Key& end, const T& data)
+{
+	this->add(Interval<Key, T>(begin, end, data));
+}
+
+template <class Key, class T>
+template <typename Container>
+void ShardedIntervalTree<Key, T>::update(const Container& intervals)
+{
+	for (const auto& iv : intervals)
+	{
+		this->add(iv);
+	}
+}
+
+/*
+Ȱ䰴Ƭ࣬ΪÿǿշƬһÿƬֻһ
+*/
+template <class Key, class T>
+template <typename Container>
+void ShardedIntervalTree<Key, T>::update_parallel(const Container& intervals, QThreadPool* pool)
+{
+	if (!pool)
+	{
+		pool = QThreadPool::globalInstance();
+	}
+
+	QVector<QList<Interval<Key, T>>> batches(this->shards.size());
+	for (const auto& iv : intervals)
+	{
+		batches[this->shard_index(iv.begin)].append(iv);
+	}
+
+	QSemaphore done;
+	int started = 0;
+	for (int i = 0; i < batches.size(); i++)
+	{
+		if (batches[i].isEmpty())
+		{
+			continue;
+		}
+		Shard* shard = this->shards[i];
+		const QList<Interval<Key, T>>* batch = &batches[i];
+		pool->start(new ShardedIntervalTreeTask([shard, batch]()
+		{
+			QMutexLocker locker(&shard->mutex);
+			shard->tree.update(*batch);
+		}, &done));
+		started++;
+	}
+	done.acquire(started);
+}
+
+template <class Key, class T>
+void ShardedIntervalTree<Key, T>::remove(const Interval<Key, T>& interval)
+{
+	Shard* shard = this->shards[this->shard_index(interval.begin)];
+	QMutexLocker locker(&shard->mutex);
+	shard->tree.remove(interval);
+}
+
+template <class Key, class T>
+void ShardedIntervalTree<Key, T>::discard(const Interval<Key, T>& interval)
+{
+	Shard* shard = this->shards[this->shard_index(interval.begin)];
+	QMutexLocker locker(&shard->mutex);
+	shard->tree.discard(interval);
+}
+
+template <class Key, class T>
+void ShardedIntervalTree<Key, T>::clear()
+{
+	for (Shard* shard : this->shards)
+	{
+		QMutexLocker locker(&shard->mutex);
+		shard->tree.clear();
+	}
+}
+
+/*
+Ƭibegin >= split_points[i-1]end <= ÷Ƭboundary_tablekey
+[begin, end)ûнķƬֱǰзƬ
+*/
+template <class Key, class T>
+bool ShardedIntervalTree<Key, T>::shard_hit(int index, const Key& begin, const Key& end) const
+{
+	const IntervalTree<Key, T>& tree = this->shards[index]->tree;
+	if (tree.boundary_table.isEmpty())
+	{
+		return false;
+	}
+	if (index > 0 && !(this->split_points[index - 1] < end))
+	{
+		return false;
+	}
+	return tree.boundary_table.lastKey() > begin;
+}
+
+template <class Key, class T>
+QSet<Interval<Key, T>> ShardedIntervalTree<Key, T>::at(const Key& p) const
+{
+	QSet<Interval<Key, T>> result;
+	int last = this->shard_index(p);
+	for (int i = 0; i <= last; i++)
+	{
+		Shard* shard = this->shards[i];
+		QMutexLocker locker(&shard->mutex);
+		if (!shard->tree.boundary_table.isEmpty() && shard->tree.boundary_table.lastKey() > p)
+		{
+			result += shard->tree.at(p);
+		}
+	}
+	return result;
+}
+
+template <class Key, class T>
+QSet<Interval<Key, T>> ShardedIntervalTree<Key, T>::overlap(const Key& begin, const Key& end) const
+{
+	QSet<Interval<Key, T>> result;
+	for (int i = 0; i < this->shards.size(); i++)
+	{
+		const Shard* shard = this->shards[i];
+		QMutexLocker locker(&shard->mutex);
+		if (this->shard_hit(i, begin, end))
+		{
+			result += shard->tree.overlap(begin, end);
+		}
+	}
+	return result;
+}
+
+template <class Key, class T>
+QSet<Interval<Key, T>> ShardedIntervalTree<Key, T>::envelop(const Key& begin, const Key& end) const
+{
+	QSet<Interval<Key, T>> result;
+	for (int i = 0; i < this->shards.size(); i++)
+	{
+		const Shard* shard = this->shards[i];
+		QMutexLocker locker(&shard->mutex);
+		if (this->shard_hit(i, begin, end))
+		{
+			result += shard->tree.envelop(begin, end);
+		}
+	}
+	return result;
+}
+
+/*
+ÿеķƬһ񣬸дԼbufferڵ߳кϲ
+*/
+template <class Key, class T>
+QSet<Interval<Key, T>> ShardedIntervalTree<Key, T>::overlap_parallel(const Key& begin, const Key& end,
+	QThreadPool* pool) const
+{
+	QSet<Interval<Key, T>> result;
+	if (begin >= end)
+	{
+		return result;
+	}
+	if (!pool)
+	{
+		pool = QThreadPool::globalInstance();
+	}
+
+	QVector<QList<Interval<Key, T>>> buffers(this->shards.size());
+	QSemaphore done;
+	for (int i = 0; i < this->shards.size(); i++)
+	{
+		const Shard* shard = this->shards[i];
+		QList<Interval<Key, T>>* buffer = &buffers[i];
+		const ShardedIntervalTree* self = this;
+		pool->start(new ShardedIntervalTreeTask([self, shard, buffer, i, begin, end]()
+		{
+			QMutexLocker locker(&shard->mutex);
+			if (self->shard_hit(i, begin, end) && shard->tree.top_node)
+			{
+				shard->tree.top_node->search_range(begin, end, false, *buffer);
+			}
+		}, &done));
+	}
+	done.acquire(this->shards.size());
+
+	int total = 0;
+	for (const auto& buffer : buffers)
+	{
+		total += buffer.size();
+	}
+	result.reserve(total);
+	for (const auto& buffer : buffers)
+	{
+		for (const auto& iv : buffer)
+		{
+			result.insert(iv);
+		}
+	}
+	return result;
+}
+
+template <class Key, class T>
+bool ShardedIntervalTree<Key, T>::__contains__(const Interval<Key, T>& item) const
+{
+	const Shard* shard = this->shards[this->shard_index(item.begin)];
+	QMutexLocker locker(&shard->mutex);
+	return shard->tree.all_intervals.contains(item);
+}
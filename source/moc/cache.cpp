@@ -0,0 +1,260 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "cache.h"
+
+#include <qcoreapplication.h>
+#include <qcryptographichash.h>
+#include <qdatetime.h>
+#include <qdir.h>
+#include <qfile.h>
+#include <qfileinfo.h>
+#include <qsavefile.h>
+
+QT_BEGIN_NAMESPACE
+
+static const char manifestMagic[] = "moc-cache 2";
+
+// write atomically, so that concurrent moc processes never see partial files
+static bool writeFileAtomically(const QString &fileName, const QByteArray &data)
+{
+    QDir().mkpath(QFileInfo(fileName).path());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    if (file.write(data) != data.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+// "dep <size> <mtime> <hash> <path>", the path may contain spaces
+static bool parseDependency(const QByteArray &line, MocCache::Dependency *dep)
+{
+    int fieldStart = 4;
+    QByteArray fields[3];
+    for (int i = 0; i < 3; ++i) {
+        const int space = line.indexOf(' ', fieldStart);
+        if (space == -1)
+            return false;
+        fields[i] = line.mid(fieldStart, space - fieldStart);
+        fieldStart = space + 1;
+    }
+    bool sizeOk, timeOk;
+    dep->size = fields[0].toLongLong(&sizeOk);
+    dep->lastModified = fields[1].toLongLong(&timeOk);
+    dep->hash = fields[2];
+    dep->path = line.mid(fieldStart);
+    return sizeOk && timeOk && !dep->path.isEmpty();
+}
+
+MocCache::MocCache(const QString &directory)
+    : dir(directory), hitCount(0), missCount(0)
+{
+}
+
+MocCache::~MocCache()
+{
+    writeRunStatistics();
+}
+
+QByteArray MocCache::hashData(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+bool MocCache::dependencyFromFile(const QByteArray &path, Dependency *dep)
+{
+    QFile file(QString::fromLocal8Bit(path.constData()));
+    if (!file.open(QFile::ReadOnly))
+        return false;
+    const QFileInfo fi(file);
+    dep->path = path;
+    dep->size = fi.size();
+    dep->lastModified = fi.lastModified().toMSecsSinceEpoch();
+    dep->hash = hashData(file.readAll());
+    return true;
+}
+
+QString MocCache::manifestPath(const QByteArray &key) const
+{
+    return dir + QLatin1String("/manifests/") + QString::fromLatin1(key.left(2))
+            + QLatin1Char('/') + QString::fromLatin1(key.mid(2));
+}
+
+QString MocCache::objectPath(const QByteArray &hash) const
+{
+    return dir + QLatin1String("/objects/") + QString::fromLatin1(hash.left(2))
+            + QLatin1Char('/') + QString::fromLatin1(hash.mid(2));
+}
+
+bool MocCache::readObject(const QByteArray &hash, QByteArray *data) const
+{
+    QFile object(objectPath(hash));
+    if (!object.open(QFile::ReadOnly))
+        return false;
+    *data = object.readAll();
+    return hashData(*data) == hash;
+}
+
+bool MocCache::writeObject(const QByteArray &data, QByteArray *hash) const
+{
+    *hash = hashData(data);
+    const QString objectFile = objectPath(*hash);
+    return QFile::exists(objectFile) || writeFileAtomically(objectFile, data);
+}
+
+bool MocCache::lookup(const QByteArray &key, QByteArray *output, QByteArray *messages,
+                      QList<QByteArray> *dependencies) const
+{
+    QFile manifest(manifestPath(key));
+    if (!manifest.open(QFile::ReadOnly))
+        return false;
+    const QList<QByteArray> lines = manifest.readAll().split('\n');
+    manifest.close();
+    if (lines.isEmpty() || lines.first() != manifestMagic)
+        return false;
+
+    QByteArray outputHash, messagesHash;
+    QList<QByteArray> paths;
+    for (int i = 1; i < lines.size(); ++i) {
+        const QByteArray &line = lines.at(i);
+        if (line.startsWith("output ")) {
+            outputHash = line.mid(7);
+        } else if (line.startsWith("messages ")) {
+            messagesHash = line.mid(9);
+        } else if (line.startsWith("dep ")) {
+            Dependency recorded;
+            if (!parseDependency(line, &recorded))
+                return false;
+            const QFileInfo fi(QString::fromLocal8Bit(recorded.path.constData()));
+            if (!fi.exists())
+                return false;
+            paths.append(recorded.path);
+            // unchanged size and time stamp: don't bother reading the file
+            if (fi.size() == recorded.size && fi.lastModified().toMSecsSinceEpoch() == recorded.lastModified)
+                continue;
+            Dependency current;
+            if (!dependencyFromFile(recorded.path, &current) || current.hash != recorded.hash)
+                return false;
+        }
+    }
+    if (outputHash.isEmpty())
+        return false;
+
+    if (!readObject(outputHash, output))
+        return false;
+    messages->clear();
+    if (!messagesHash.isEmpty() && !readObject(messagesHash, messages))
+        return false;
+    if (dependencies)
+        *dependencies = paths;
+    return true;
+}
+
+bool MocCache::store(const QByteArray &key, const QList<Dependency> &dependencies, const QByteArray &output,
+                     const QByteArray &messages) const
+{
+    QByteArray outputHash, messagesHash;
+    if (!writeObject(output, &outputHash))
+        return false;
+    if (!messages.isEmpty() && !writeObject(messages, &messagesHash))
+        return false;
+
+    QByteArray manifest(manifestMagic);
+    manifest += '\n';
+    manifest += "output " + outputHash + '\n';
+    if (!messagesHash.isEmpty())
+        manifest += "messages " + messagesHash + '\n';
+    foreach (const Dependency &dep, dependencies) {
+        manifest += "dep ";
+        manifest += QByteArray::number(dep.size) + ' ';
+        manifest += QByteArray::number(dep.lastModified) + ' ';
+        manifest += dep.hash + ' ';
+        manifest += dep.path + '\n';
+    }
+    return writeFileAtomically(manifestPath(key), manifest);
+}
+
+void MocCache::recordResult(bool hit) const
+{
+    if (hit)
+        hitCount.ref();
+    else
+        missCount.ref();
+}
+
+// the file name is unique to this process and cache object
+void MocCache::writeRunStatistics() const
+{
+    const int hits = hitCount.load();
+    const int misses = missCount.load();
+    if (!hits && !misses)
+        return;
+    static QAtomicInt caches;
+    const QString fileName = QString::fromLatin1("%1/runs/%2-%3-%4").arg(dir)
+            .arg(QCoreApplication::applicationPid())
+            .arg(QDateTime::currentMSecsSinceEpoch())
+            .arg(caches.fetchAndAddRelaxed(1));
+    writeFileAtomically(fileName, "hits " + QByteArray::number(hits) + "\nmisses " + QByteArray::number(misses) + '\n');
+}
+
+void MocCache::readStatistics(qint64 *hits, qint64 *misses) const
+{
+    *hits = *misses = 0;
+    const QDir runs(dir + QLatin1String("/runs"));
+    foreach (const QString &fileName, runs.entryList(QDir::Files)) {
+        QFile file(runs.filePath(fileName));
+        if (!file.open(QFile::ReadOnly))
+            continue;
+        foreach (const QByteArray &line, file.readAll().split('\n')) {
+            if (line.startsWith("hits "))
+                *hits += line.mid(5).toLongLong();
+            else if (line.startsWith("misses "))
+                *misses += line.mid(7).toLongLong();
+        }
+    }
+}
+
+QByteArray MocCache::statistics() const
+{
+    qint64 hits, misses;
+    readStatistics(&hits, &misses);
+    const qint64 total = hits + misses;
+    QByteArray result;
+    result += "cache directory: " + QFile::encodeName(QDir(dir).absolutePath()) + '\n';
+    result += "hits:            " + QByteArray::number(hits) + '\n';
+    result += "misses:          " + QByteArray::number(misses) + '\n';
+    result += "hit rate:        " + QByteArray::number(total ? 100.0 * hits / total : 0.0, 'f', 1) + "%\n";
+    return result;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,105 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <qatomic.h>
+#include <qbytearray.h>
+#include <qlist.h>
+#include <qstring.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    On-disk cache of moc results.
+
+    A run is identified by a key computed from the input file and every
+    option that influences the generated code. For each key a manifest
+    records the files that were read while processing the input (the
+    input itself, all files in Preprocessor::preprocessedIncludes and
+    plugin meta data files) together with their size, modification time
+    and content hash, and the hashes of the generated output and of the
+    warnings and notes moc printed, which are printed again on a hit.
+    Both live in a content-addressed object store, so identical outputs
+    are stored only once.
+
+    A lookup is a hit when every recorded dependency still has the same
+    content. Files that were not found when the result was created (for
+    instance a header that would now shadow another one in the include
+    path) are not tracked.
+
+    Hits and misses are counted in memory. When the cache object is
+    destroyed, the counts go to a new file of their own in the "runs"
+    subdirectory, so parallel moc processes never write the same file;
+    statistics() adds them up.
+*/
+class MocCache
+{
+public:
+    struct Dependency
+    {
+        QByteArray path;
+        qint64 size;
+        qint64 lastModified;
+        QByteArray hash;
+    };
+
+    explicit MocCache(const QString &directory);
+    ~MocCache();
+
+    static QByteArray hashData(const QByteArray &data);
+    static bool dependencyFromFile(const QByteArray &path, Dependency *dep);
+
+    bool lookup(const QByteArray &key, QByteArray *output, QByteArray *messages,
+                QList<QByteArray> *dependencies = 0) const;
+    bool store(const QByteArray &key, const QList<Dependency> &dependencies, const QByteArray &output,
+               const QByteArray &messages) const;
+
+    void recordResult(bool hit) const;
+    QByteArray statistics() const;
+
+private:
+    QString manifestPath(const QByteArray &key) const;
+    QString objectPath(const QByteArray &hash) const;
+    bool readObject(const QByteArray &hash, QByteArray *data) const;
+    bool writeObject(const QByteArray &data, QByteArray *hash) const;
+    void writeRunStatistics() const;
+    void readStatistics(qint64 *hits, qint64 *misses) const;
+
+    QString dir;
+    // recordResult() may be called from several threads
+    mutable QAtomicInt hitCount;
+    mutable QAtomicInt missCount;
+};
+
+QT_END_NAMESPACE
+
+#endif // CACHE_H
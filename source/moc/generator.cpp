@@ -41,7 +41,10 @@
 #include <QtCore/qjsonvalue.h>
 #include <QtCore/qjsonarray.h>
 #include <QtCore/qplugin.h>
+#include <QtCore/qpair.h>
 #include <stdio.h>
+#include <limits.h>
+#include <algorithm>
 
 #include <QtCore/5.6.3/QtCore/private/qmetaobject_p.h> //for the flags.
 
@@ -79,9 +82,9 @@ QT_FOR_EACH_STATIC_TYPE(RETURN_METATYPENAME_STRING)
     return 0;
  }
 
-Generator::Generator(ClassDef *classDef, const QList<QByteArray> &metaTypes, const QHash<QByteArray, QByteArray> &knownQObjectClasses, const QHash<QByteArray, QByteArray> &knownGadgets, FILE *outfile)
-    : out(outfile), cdef(classDef), metaTypes(metaTypes), knownQObjectClasses(knownQObjectClasses)
-    , knownGadgets(knownGadgets)
+Generator::Generator(ClassDef *classDef, const QList<QByteArray> &metaTypes, const QHash<QByteArray, QByteArray> &knownQObjectClasses, const QHash<QByteArray, QByteArray> &knownGadgets, OutputBuffer *outfile)
+    : out(outfile), cdef(classDef), generateNameIndex(false), metaTypes(metaTypes)
+    , knownQObjectClasses(knownQObjectClasses), knownGadgets(knownGadgets)
 {
     if (cdef->superclassList.size())
         purestSuperClass = cdef->superclassList.first().first;
@@ -112,13 +115,15 @@ static inline int lengthOfEscapeSequence(const QByteArray &s, int i)
 
 void Generator::strreg(const QByteArray &s)
 {
-    if (!strings.contains(s))
+    if (!stringIndexes.contains(s)) {
+        stringIndexes.insert(s, strings.size());
         strings.append(s);
+    }
 }
 
 int Generator::stridx(const QByteArray &s)
 {
-    int i = strings.indexOf(s);
+    int i = stringIndexes.value(s, -1);
     Q_ASSERT_X(i != -1, Q_FUNC_INFO, "We forgot to register some strings");
     return i;
 }
@@ -231,8 +236,8 @@ void Generator::generateCode()
 // Build stringdata struct
 //
     const int constCharArraySizeLimit = 65535;
-    fprintf(out, "struct qt_meta_stringdata_%s_t {\n", qualifiedClassNameIdentifier.constData());
-    fprintf(out, "    QByteArrayData data[%d];\n", strings.size());
+    out->print("struct qt_meta_stringdata_%s_t {\n", qualifiedClassNameIdentifier.constData());
+    out->print("    QByteArrayData data[%d];\n", strings.size());
     {
         int stringDataLength = 0;
         int stringDataCounter = 0;
@@ -241,39 +246,39 @@ void Generator::generateCode()
             stringDataLength += thisLength;
             if (stringDataLength / constCharArraySizeLimit) {
                 // save previous stringdata and start computing the next one.
-                fprintf(out, "    char stringdata%d[%d];\n", stringDataCounter++, stringDataLength - thisLength);
+                out->print("    char stringdata%d[%d];\n", stringDataCounter++, stringDataLength - thisLength);
                 stringDataLength = thisLength;
             }
         }
-        fprintf(out, "    char stringdata%d[%d];\n", stringDataCounter, stringDataLength);
+        out->print("    char stringdata%d[%d];\n", stringDataCounter, stringDataLength);
 
     }
-    fprintf(out, "};\n");
+    out->write("};\n");
 
     // Macro that expands into a QByteArrayData. The offset member is
     // calculated from 1) the offset of the actual characters in the
     // stringdata.stringdata member, and 2) the stringdata.data index of the
     // QByteArrayData being defined. This calculation relies on the
     // QByteArrayData::data() implementation returning simply "this + offset".
-    fprintf(out, "#define QT_MOC_LITERAL(idx, ofs, len) \\\n"
+    out->print("#define QT_MOC_LITERAL(idx, ofs, len) \\\n"
             "    Q_STATIC_BYTE_ARRAY_DATA_HEADER_INITIALIZER_WITH_OFFSET(len, \\\n"
             "    qptrdiff(offsetof(qt_meta_stringdata_%s_t, stringdata0) + ofs \\\n"
             "        - idx * sizeof(QByteArrayData)) \\\n"
             "    )\n",
             qualifiedClassNameIdentifier.constData());
 
-    fprintf(out, "static const qt_meta_stringdata_%s_t qt_meta_stringdata_%s = {\n",
+    out->print("static const qt_meta_stringdata_%s_t qt_meta_stringdata_%s = {\n",
             qualifiedClassNameIdentifier.constData(), qualifiedClassNameIdentifier.constData());
-    fprintf(out, "    {\n");
+    out->write("    {\n");
     {
         int idx = 0;
         for (int i = 0; i < strings.size(); ++i) {
             const QByteArray &str = strings.at(i);
-            fprintf(out, "QT_MOC_LITERAL(%d, %d, %d)", i, idx, str.length());
+            out->print("QT_MOC_LITERAL(%d, %d, %d)", i, idx, str.length());
             if (i != strings.size() - 1)
-                fputc(',', out);
+                out->write(',');
             const QByteArray comment = str.length() > 32 ? str.left(29) + "..." : str;
-            fprintf(out, " // \"%s\"\n", comment.constData());
+            out->print(" // \"%s\"\n", comment.constData());
             idx += str.length() + 1;
             for (int j = 0; j < str.length(); ++j) {
                 if (str.at(j) == '\\') {
@@ -283,13 +288,13 @@ void Generator::generateCode()
                 }
             }
         }
-        fprintf(out, "\n    },\n");
+        out->write("\n    },\n");
     }
 
 //
 // Build stringdata array
 //
-    fprintf(out, "    \"");
+    out->write("    \"");
     int col = 0;
     int len = 0;
     int stringDataLength = 0;
@@ -298,24 +303,24 @@ void Generator::generateCode()
         len = s.length();
         stringDataLength += len + 1;
         if (stringDataLength >= constCharArraySizeLimit) {
-            fprintf(out, "\",\n    \"");
+            out->write("\",\n    \"");
             stringDataLength = len + 1;
             col = 0;
         } else if (i)
-            fputs("\\0", out); // add \0 at the end of each string
+            out->write("\\0"); // add \0 at the end of each string
 
         if (col && col + len >= 72) {
-            fprintf(out, "\"\n    \"");
+            out->write("\"\n    \"");
             col = 0;
         } else if (len && s.at(0) >= '0' && s.at(0) <= '9') {
-            fprintf(out, "\"\"");
+            out->write("\"\"");
             len += 2;
         }
         int idx = 0;
         while (idx < s.length()) {
             if (idx > 0) {
                 col = 0;
-                fprintf(out, "\"\n    \"");
+                out->write("\"\n    \"");
             }
             int spanLen = qMin(70, s.length() - idx);
             // don't cut escape sequences at the end of a line
@@ -324,7 +329,7 @@ void Generator::generateCode()
                 int escapeLen = lengthOfEscapeSequence(s, backSlashPos);
                 spanLen = qBound(spanLen, backSlashPos + escapeLen - idx, s.length() - idx);
             }
-            fprintf(out, "%.*s", spanLen, s.constData() + idx);
+            out->write(s.constData() + idx, spanLen);
             idx += spanLen;
             col += spanLen;
         }
@@ -332,23 +337,23 @@ void Generator::generateCode()
     }
 
 // Terminate stringdata struct
-    fprintf(out, "\"\n};\n");
-    fprintf(out, "#undef QT_MOC_LITERAL\n\n");
+    out->write("\"\n};\n");
+    out->write("#undef QT_MOC_LITERAL\n\n");
 
 //
 // build the data array
 //
 
     int index = MetaObjectPrivateFieldCount;
-    fprintf(out, "static const uint qt_meta_data_%s[] = {\n", qualifiedClassNameIdentifier.constData());
-    fprintf(out, "\n // content:\n");
-    fprintf(out, "    %4d,       // revision\n", int(QMetaObjectPrivate::OutputRevision));
-    fprintf(out, "    %4d,       // classname\n", stridx(cdef->qualified));
-    fprintf(out, "    %4d, %4d, // classinfo\n", cdef->classInfoList.count(), cdef->classInfoList.count() ? index : 0);
+    out->print("static const uint qt_meta_data_%s[] = {\n", qualifiedClassNameIdentifier.constData());
+    out->write("\n // content:\n");
+    out->print("    %4d,       // revision\n", int(QMetaObjectPrivate::OutputRevision));
+    out->print("    %4d,       // classname\n", stridx(cdef->qualified));
+    out->print("    %4d, %4d, // classinfo\n", cdef->classInfoList.count(), cdef->classInfoList.count() ? index : 0);
     index += cdef->classInfoList.count() * 2;
 
     int methodCount = cdef->signalList.count() + cdef->slotList.count() + cdef->methodList.count();
-    fprintf(out, "    %4d, %4d, // methods\n", methodCount, methodCount ? index : 0);
+    out->print("    %4d, %4d, // methods\n", methodCount, methodCount ? index : 0);
     index += methodCount * 5;
     if (cdef->revisionedMethods)
         index += methodCount;
@@ -361,18 +366,18 @@ void Generator::generateCode()
             - methodCount // return "parameters" don't have names
             - cdef->constructorList.count(); // "this" parameters don't have names
 
-    fprintf(out, "    %4d, %4d, // properties\n", cdef->propertyList.count(), cdef->propertyList.count() ? index : 0);
+    out->print("    %4d, %4d, // properties\n", cdef->propertyList.count(), cdef->propertyList.count() ? index : 0);
     index += cdef->propertyList.count() * 3;
     if(cdef->notifyableProperties)
         index += cdef->propertyList.count();
     if (cdef->revisionedProperties)
         index += cdef->propertyList.count();
-    fprintf(out, "    %4d, %4d, // enums/sets\n", cdef->enumList.count(), cdef->enumList.count() ? index : 0);
+    out->print("    %4d, %4d, // enums/sets\n", cdef->enumList.count(), cdef->enumList.count() ? index : 0);
 
     int enumsIndex = index;
     for (int i = 0; i < cdef->enumList.count(); ++i)
         index += 4 + (cdef->enumList.at(i).values.count() * 2);
-    fprintf(out, "    %4d, %4d, // constructors\n", isConstructible ? cdef->constructorList.count() : 0,
+    out->print("    %4d, %4d, // constructors\n", isConstructible ? cdef->constructorList.count() : 0,
             isConstructible ? index : 0);
 
     int flags = 0;
@@ -381,8 +386,8 @@ void Generator::generateCode()
         // by qdbusxml2cpp which generate code that require that we call qt_metacall for properties
         flags |= PropertyAccessInStaticMetaCall;
     }
-    fprintf(out, "    %4d,       // flags\n", flags);
-    fprintf(out, "    %4d,       // signalCount\n", cdef->signalList.count());
+    out->print("    %4d,       // flags\n", flags);
+    out->print("    %4d,       // signalCount\n", cdef->signalList.count());
 
 
 //
@@ -442,7 +447,7 @@ void Generator::generateCode()
 //
 // Terminate data array
 //
-    fprintf(out, "\n       0        // eod\n};\n\n");
+    out->write("\n       0        // eod\n};\n\n");
 
 //
 // Generate internal qt_static_metacall() function
@@ -514,40 +519,43 @@ void Generator::generateCode()
     }
 
     if (!extraList.isEmpty()) {
-        fprintf(out, "static const QMetaObject * const qt_meta_extradata_%s[] = {\n    ", qualifiedClassNameIdentifier.constData());
+        out->print("static const QMetaObject * const qt_meta_extradata_%s[] = {\n    ", qualifiedClassNameIdentifier.constData());
         for (int i = 0; i < extraList.count(); ++i) {
-            fprintf(out, "    &%s::staticMetaObject,\n", extraList.at(i).constData());
+            out->print("    &%s::staticMetaObject,\n", extraList.at(i).constData());
         }
-        fprintf(out, "    Q_NULLPTR\n};\n\n");
+        out->write("    Q_NULLPTR\n};\n\n");
     }
 
 //
 // Finally create and initialize the static meta object
 //
     if (isQt)
-        fprintf(out, "const QMetaObject QObject::staticQtMetaObject = {\n");
+        out->write("const QMetaObject QObject::staticQtMetaObject = {\n");
     else
-        fprintf(out, "const QMetaObject %s::staticMetaObject = {\n", cdef->qualified.constData());
+        out->print("const QMetaObject %s::staticMetaObject = {\n", cdef->qualified.constData());
 
     if (isQObject)
-        fprintf(out, "    { Q_NULLPTR, ");
+        out->write("    { Q_NULLPTR, ");
     else if (cdef->superclassList.size() && (!cdef->hasQGadget || knownGadgets.contains(purestSuperClass)))
-        fprintf(out, "    { &%s::staticMetaObject, ", purestSuperClass.constData());
+        out->print("    { &%s::staticMetaObject, ", purestSuperClass.constData());
     else
-        fprintf(out, "    { Q_NULLPTR, ");
-    fprintf(out, "qt_meta_stringdata_%s.data,\n"
+        out->write("    { Q_NULLPTR, ");
+    out->print("qt_meta_stringdata_%s.data,\n"
             "      qt_meta_data_%s, ", qualifiedClassNameIdentifier.constData(),
             qualifiedClassNameIdentifier.constData());
     if (hasStaticMetaCall)
-        fprintf(out, " qt_static_metacall, ");
+        out->write(" qt_static_metacall, ");
     else
-        fprintf(out, " Q_NULLPTR, ");
+        out->write(" Q_NULLPTR, ");
 
     if (extraList.isEmpty())
-        fprintf(out, "Q_NULLPTR, ");
+        out->write("Q_NULLPTR, ");
     else
-        fprintf(out, "qt_meta_extradata_%s, ", qualifiedClassNameIdentifier.constData());
-    fprintf(out, "Q_NULLPTR}\n};\n\n");
+        out->print("qt_meta_extradata_%s, ", qualifiedClassNameIdentifier.constData());
+    out->write("Q_NULLPTR}\n};\n\n");
+
+    if (generateNameIndex && !isQt)
+        generateNameIndexes();
 
     if(isQt)
         return;
@@ -555,41 +563,41 @@ void Generator::generateCode()
     if (!cdef->hasQObject)
         return;
 
-    fprintf(out, "\nconst QMetaObject *%s::metaObject() const\n{\n    return QObject::d_ptr->metaObject ? QObject::d_ptr->dynamicMetaObject() : &staticMetaObject;\n}\n",
+    out->print("\nconst QMetaObject *%s::metaObject() const\n{\n    return QObject::d_ptr->metaObject ? QObject::d_ptr->dynamicMetaObject() : &staticMetaObject;\n}\n",
             cdef->qualified.constData());
 
 //
 // Generate smart cast function
 //
-    fprintf(out, "\nvoid *%s::qt_metacast(const char *_clname)\n{\n", cdef->qualified.constData());
-    fprintf(out, "    if (!_clname) return Q_NULLPTR;\n");
-    fprintf(out, "    if (!strcmp(_clname, qt_meta_stringdata_%s.stringdata0))\n"
+    out->print("\nvoid *%s::qt_metacast(const char *_clname)\n{\n", cdef->qualified.constData());
+    out->write("    if (!_clname) return Q_NULLPTR;\n");
+    out->print("    if (!strcmp(_clname, qt_meta_stringdata_%s.stringdata0))\n"
                   "        return static_cast<void*>(const_cast< %s*>(this));\n",
             qualifiedClassNameIdentifier.constData(), cdef->classname.constData());
     for (int i = 1; i < cdef->superclassList.size(); ++i) { // for all superclasses but the first one
         if (cdef->superclassList.at(i).second == FunctionDef::Private)
             continue;
         const char *cname = cdef->superclassList.at(i).first.constData();
-        fprintf(out, "    if (!strcmp(_clname, \"%s\"))\n        return static_cast< %s*>(const_cast< %s*>(this));\n",
+        out->print("    if (!strcmp(_clname, \"%s\"))\n        return static_cast< %s*>(const_cast< %s*>(this));\n",
                 cname, cname, cdef->classname.constData());
     }
     for (int i = 0; i < cdef->interfaceList.size(); ++i) {
         const QList<ClassDef::Interface> &iface = cdef->interfaceList.at(i);
         for (int j = 0; j < iface.size(); ++j) {
-            fprintf(out, "    if (!strcmp(_clname, %s))\n        return ", iface.at(j).interfaceId.constData());
+            out->print("    if (!strcmp(_clname, %s))\n        return ", iface.at(j).interfaceId.constData());
             for (int k = j; k >= 0; --k)
-                fprintf(out, "static_cast< %s*>(", iface.at(k).className.constData());
-            fprintf(out, "const_cast< %s*>(this)%s;\n",
+                out->print("static_cast< %s*>(", iface.at(k).className.constData());
+            out->print("const_cast< %s*>(this)%s;\n",
                     cdef->classname.constData(), QByteArray(j+1, ')').constData());
         }
     }
     if (!purestSuperClass.isEmpty() && !isQObject) {
         QByteArray superClass = purestSuperClass;
-        fprintf(out, "    return %s::qt_metacast(_clname);\n", superClass.constData());
+        out->print("    return %s::qt_metacast(_clname);\n", superClass.constData());
     } else {
-        fprintf(out, "    return Q_NULLPTR;\n");
+        out->write("    return Q_NULLPTR;\n");
     }
-    fprintf(out, "}\n");
+    out->write("}\n");
 
 //
 // Generate internal qt_metacall()  function
@@ -623,11 +631,11 @@ void Generator::generateClassInfos()
     if (cdef->classInfoList.isEmpty())
         return;
 
-    fprintf(out, "\n // classinfo: key, value\n");
+    out->write("\n // classinfo: key, value\n");
 
     for (int i = 0; i < cdef->classInfoList.size(); ++i) {
         const ClassInfoDef &c = cdef->classInfoList.at(i);
-        fprintf(out, "    %4d, %4d,\n", stridx(c.name), stridx(c.value));
+        out->print("    %4d, %4d,\n", stridx(c.name), stridx(c.value));
     }
 }
 
@@ -655,7 +663,7 @@ void Generator::generateFunctions(const QList<FunctionDef>& list, const char *fu
 {
     if (list.isEmpty())
         return;
-    fprintf(out, "\n // %ss: name, argc, parameters, tag, flags\n", functype);
+    out->print("\n // %ss: name, argc, parameters, tag, flags\n", functype);
 
     for (int i = 0; i < list.count(); ++i) {
         const FunctionDef &f = list.at(i);
@@ -690,7 +698,7 @@ void Generator::generateFunctions(const QList<FunctionDef>& list, const char *fu
         }
 
         int argc = f.arguments.count();
-        fprintf(out, "    %4d, %4d, %4d, %4d, 0x%02x /* %s */,\n",
+        out->print("    %4d, %4d, %4d, %4d, 0x%02x /* %s */,\n",
             stridx(f.name), argc, paramsIndex, stridx(f.tag), flags, comment.constData());
 
         paramsIndex += 1 + argc * 2;
@@ -700,10 +708,10 @@ void Generator::generateFunctions(const QList<FunctionDef>& list, const char *fu
 void Generator::generateFunctionRevisions(const QList<FunctionDef>& list, const char *functype)
 {
     if (list.count())
-        fprintf(out, "\n // %ss: revision\n", functype);
+        out->print("\n // %ss: revision\n", functype);
     for (int i = 0; i < list.count(); ++i) {
         const FunctionDef &f = list.at(i);
-        fprintf(out, "    %4d,\n", f.revision);
+        out->print("    %4d,\n", f.revision);
     }
 }
 
@@ -711,28 +719,28 @@ void Generator::generateFunctionParameters(const QList<FunctionDef>& list, const
 {
     if (list.isEmpty())
         return;
-    fprintf(out, "\n // %ss: parameters\n", functype);
+    out->print("\n // %ss: parameters\n", functype);
     for (int i = 0; i < list.count(); ++i) {
         const FunctionDef &f = list.at(i);
-        fprintf(out, "    ");
+        out->write("    ");
 
         // Types
         int argsCount = f.arguments.count();
         for (int j = -1; j < argsCount; ++j) {
             if (j > -1)
-                fputc(' ', out);
+                out->write(' ');
             const QByteArray &typeName = (j < 0) ? f.normalizedType : f.arguments.at(j).normalizedType;
             generateTypeInfo(typeName, /*allowEmptyName=*/f.isConstructor);
-            fputc(',', out);
+            out->write(',');
         }
 
         // Parameter names
         for (int j = 0; j < argsCount; ++j) {
             const ArgumentDef &arg = f.arguments.at(j);
-            fprintf(out, " %4d,", stridx(arg.name));
+            out->print(" %4d,", stridx(arg.name));
         }
 
-        fprintf(out, "\n");
+        out->write("\n");
     }
 }
 
@@ -750,14 +758,14 @@ void Generator::generateTypeInfo(const QByteArray &typeName, bool allowEmptyName
             valueString = metaTypeEnumValueString(type);
         }
         if (valueString) {
-            fprintf(out, "QMetaType::%s", valueString);
+            out->print("QMetaType::%s", valueString);
         } else {
             Q_ASSERT(type != QMetaType::UnknownType);
-            fprintf(out, "%4d", type);
+            out->print("%4d", type);
         }
     } else {
         Q_ASSERT(!typeName.isEmpty() || allowEmptyName);
-        fprintf(out, "0x%.8x | %d", IsUnresolvedType, stridx(typeName));
+        out->print("0x%.8x | %d", IsUnresolvedType, stridx(typeName));
     }
 }
 
@@ -778,7 +786,7 @@ void Generator::generateProperties()
     //
 
     if (cdef->propertyList.count())
-        fprintf(out, "\n // properties: name, type, flags\n");
+        out->write("\n // properties: name, type, flags\n");
     for (int i = 0; i < cdef->propertyList.count(); ++i) {
         const PropertyDef &p = cdef->propertyList.at(i);
         uint flags = Invalid;
@@ -835,28 +843,28 @@ void Generator::generateProperties()
         if (p.final)
             flags |= Final;
 
-        fprintf(out, "    %4d, ", stridx(p.name));
+        out->print("    %4d, ", stridx(p.name));
         generateTypeInfo(p.type);
-        fprintf(out, ", 0x%.8x,\n", flags);
+        out->print(", 0x%.8x,\n", flags);
     }
 
     if(cdef->notifyableProperties) {
-        fprintf(out, "\n // properties: notify_signal_id\n");
+        out->write("\n // properties: notify_signal_id\n");
         for (int i = 0; i < cdef->propertyList.count(); ++i) {
             const PropertyDef &p = cdef->propertyList.at(i);
             if(p.notifyId == -1)
-                fprintf(out, "    %4d,\n",
+                out->print("    %4d,\n",
                         0);
             else
-                fprintf(out, "    %4d,\n",
+                out->print("    %4d,\n",
                         p.notifyId);
         }
     }
     if (cdef->revisionedProperties) {
-        fprintf(out, "\n // properties: revision\n");
+        out->write("\n // properties: revision\n");
         for (int i = 0; i < cdef->propertyList.count(); ++i) {
             const PropertyDef &p = cdef->propertyList.at(i);
-            fprintf(out, "    %4d,\n", p.revision);
+            out->print("    %4d,\n", p.revision);
         }
     }
 }
@@ -876,12 +884,12 @@ void Generator::generateEnums(int index)
     if (cdef->enumDeclarations.isEmpty())
         return;
 
-    fprintf(out, "\n // enums: name, flags, count, data\n");
+    out->write("\n // enums: name, flags, count, data\n");
     index += 4 * cdef->enumList.count();
     int i;
     for (i = 0; i < cdef->enumList.count(); ++i) {
         const EnumDef &e = cdef->enumList.at(i);
-        fprintf(out, "    %4d, 0x%.1x, %4d, %4d,\n",
+        out->print("    %4d, 0x%.1x, %4d, %4d,\n",
                  stridx(e.name),
                  cdef->enumDeclarations.value(e.name) ? 1 : 0,
                  e.values.count(),
@@ -889,7 +897,7 @@ void Generator::generateEnums(int index)
         index += e.values.count() * 2;
     }
 
-    fprintf(out, "\n // enum data: key, value\n");
+    out->write("\n // enum data: key, value\n");
     for (i = 0; i < cdef->enumList.count(); ++i) {
         const EnumDef &e = cdef->enumList.at(i);
         for (int j = 0; j < e.values.count(); ++j) {
@@ -898,7 +906,7 @@ void Generator::generateEnums(int index)
             if (e.isEnumClass)
                 code += "::" + e.name;
             code += "::" + val;
-            fprintf(out, "    %4d, uint(%s),\n",
+            out->print("    %4d, uint(%s),\n",
                     stridx(val), code.constData());
         }
     }
@@ -908,16 +916,16 @@ void Generator::generateMetacall()
 {
     bool isQObject = (cdef->classname == "QObject");
 
-    fprintf(out, "\nint %s::qt_metacall(QMetaObject::Call _c, int _id, void **_a)\n{\n",
+    out->print("\nint %s::qt_metacall(QMetaObject::Call _c, int _id, void **_a)\n{\n",
              cdef->qualified.constData());
 
     if (!purestSuperClass.isEmpty() && !isQObject) {
         QByteArray superClass = purestSuperClass;
-        fprintf(out, "    _id = %s::qt_metacall(_c, _id, _a);\n", superClass.constData());
+        out->print("    _id = %s::qt_metacall(_c, _id, _a);\n", superClass.constData());
     }
 
-    fprintf(out, "    if (_id < 0)\n        return _id;\n");
-    fprintf(out, "    ");
+    out->write("    if (_id < 0)\n        return _id;\n");
+    out->write("    ");
 
     bool needElse = false;
     QList<FunctionDef> methodList;
@@ -927,19 +935,19 @@ void Generator::generateMetacall()
 
     if (methodList.size()) {
         needElse = true;
-        fprintf(out, "if (_c == QMetaObject::InvokeMetaMethod) {\n");
-        fprintf(out, "        if (_id < %d)\n", methodList.size());
-        fprintf(out, "            qt_static_metacall(this, _c, _id, _a);\n");
-        fprintf(out, "        _id -= %d;\n    }", methodList.size());
+        out->write("if (_c == QMetaObject::InvokeMetaMethod) {\n");
+        out->print("        if (_id < %d)\n", methodList.size());
+        out->write("            qt_static_metacall(this, _c, _id, _a);\n");
+        out->print("        _id -= %d;\n    }", methodList.size());
 
-        fprintf(out, " else if (_c == QMetaObject::RegisterMethodArgumentMetaType) {\n");
-        fprintf(out, "        if (_id < %d)\n", methodList.size());
+        out->write(" else if (_c == QMetaObject::RegisterMethodArgumentMetaType) {\n");
+        out->print("        if (_id < %d)\n", methodList.size());
 
         if (methodsWithAutomaticTypesHelper(methodList).isEmpty())
-            fprintf(out, "            *reinterpret_cast<int*>(_a[0]) = -1;\n");
+            out->write("            *reinterpret_cast<int*>(_a[0]) = -1;\n");
         else
-            fprintf(out, "            qt_static_metacall(this, _c, _id, _a);\n");
-        fprintf(out, "        _id -= %d;\n    }", methodList.size());
+            out->write("            qt_static_metacall(this, _c, _id, _a);\n");
+        out->print("        _id -= %d;\n    }", methodList.size());
 
     }
 
@@ -958,116 +966,116 @@ void Generator::generateMetacall()
             needUser |= p.user.endsWith(')');
         }
 
-        fprintf(out, "\n#ifndef QT_NO_PROPERTIES\n   ");
+        out->write("\n#ifndef QT_NO_PROPERTIES\n   ");
         if (needElse)
-            fprintf(out, "else ");
-        fprintf(out,
+            out->write("else ");
+        out->print(
             "if (_c == QMetaObject::ReadProperty || _c == QMetaObject::WriteProperty\n"
             "            || _c == QMetaObject::ResetProperty || _c == QMetaObject::RegisterPropertyMetaType) {\n"
             "        qt_static_metacall(this, _c, _id, _a);\n"
             "        _id -= %d;\n    }", cdef->propertyList.count());
 
-        fprintf(out, " else ");
-        fprintf(out, "if (_c == QMetaObject::QueryPropertyDesignable) {\n");
+        out->write(" else ");
+        out->write("if (_c == QMetaObject::QueryPropertyDesignable) {\n");
         if (needDesignable) {
-            fprintf(out, "        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
-            fprintf(out, "        switch (_id) {\n");
+            out->write("        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
+            out->write("        switch (_id) {\n");
             for (int propindex = 0; propindex < cdef->propertyList.size(); ++propindex) {
                 const PropertyDef &p = cdef->propertyList.at(propindex);
                 if (!p.designable.endsWith(')'))
                     continue;
-                fprintf(out, "        case %d: *_b = %s; break;\n",
+                out->print("        case %d: *_b = %s; break;\n",
                          propindex, p.designable.constData());
             }
-            fprintf(out, "        default: break;\n");
-            fprintf(out, "        }\n");
+            out->write("        default: break;\n");
+            out->write("        }\n");
         }
-        fprintf(out,
+        out->print(
                 "        _id -= %d;\n"
                 "    }", cdef->propertyList.count());
 
-        fprintf(out, " else ");
-        fprintf(out, "if (_c == QMetaObject::QueryPropertyScriptable) {\n");
+        out->write(" else ");
+        out->write("if (_c == QMetaObject::QueryPropertyScriptable) {\n");
         if (needScriptable) {
-            fprintf(out, "        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
-            fprintf(out, "        switch (_id) {\n");
+            out->write("        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
+            out->write("        switch (_id) {\n");
             for (int propindex = 0; propindex < cdef->propertyList.size(); ++propindex) {
                 const PropertyDef &p = cdef->propertyList.at(propindex);
                 if (!p.scriptable.endsWith(')'))
                     continue;
-                fprintf(out, "        case %d: *_b = %s; break;\n",
+                out->print("        case %d: *_b = %s; break;\n",
                          propindex, p.scriptable.constData());
             }
-            fprintf(out, "        default: break;\n");
-            fprintf(out, "        }\n");
+            out->write("        default: break;\n");
+            out->write("        }\n");
         }
-        fprintf(out,
+        out->print(
                 "        _id -= %d;\n"
                 "    }", cdef->propertyList.count());
 
-        fprintf(out, " else ");
-        fprintf(out, "if (_c == QMetaObject::QueryPropertyStored) {\n");
+        out->write(" else ");
+        out->write("if (_c == QMetaObject::QueryPropertyStored) {\n");
         if (needStored) {
-            fprintf(out, "        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
-            fprintf(out, "        switch (_id) {\n");
+            out->write("        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
+            out->write("        switch (_id) {\n");
             for (int propindex = 0; propindex < cdef->propertyList.size(); ++propindex) {
                 const PropertyDef &p = cdef->propertyList.at(propindex);
                 if (!p.stored.endsWith(')'))
                     continue;
-                fprintf(out, "        case %d: *_b = %s; break;\n",
+                out->print("        case %d: *_b = %s; break;\n",
                          propindex, p.stored.constData());
             }
-            fprintf(out, "        default: break;\n");
-            fprintf(out, "        }\n");
+            out->write("        default: break;\n");
+            out->write("        }\n");
         }
-        fprintf(out,
+        out->print(
                 "        _id -= %d;\n"
                 "    }", cdef->propertyList.count());
 
-        fprintf(out, " else ");
-        fprintf(out, "if (_c == QMetaObject::QueryPropertyEditable) {\n");
+        out->write(" else ");
+        out->write("if (_c == QMetaObject::QueryPropertyEditable) {\n");
         if (needEditable) {
-            fprintf(out, "        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
-            fprintf(out, "        switch (_id) {\n");
+            out->write("        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
+            out->write("        switch (_id) {\n");
             for (int propindex = 0; propindex < cdef->propertyList.size(); ++propindex) {
                 const PropertyDef &p = cdef->propertyList.at(propindex);
                 if (!p.editable.endsWith(')'))
                     continue;
-                fprintf(out, "        case %d: *_b = %s; break;\n",
+                out->print("        case %d: *_b = %s; break;\n",
                          propindex, p.editable.constData());
             }
-            fprintf(out, "        default: break;\n");
-            fprintf(out, "        }\n");
+            out->write("        default: break;\n");
+            out->write("        }\n");
         }
-        fprintf(out,
+        out->print(
                 "        _id -= %d;\n"
                 "    }", cdef->propertyList.count());
 
 
-        fprintf(out, " else ");
-        fprintf(out, "if (_c == QMetaObject::QueryPropertyUser) {\n");
+        out->write(" else ");
+        out->write("if (_c == QMetaObject::QueryPropertyUser) {\n");
         if (needUser) {
-            fprintf(out, "        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
-            fprintf(out, "        switch (_id) {\n");
+            out->write("        bool *_b = reinterpret_cast<bool*>(_a[0]);\n");
+            out->write("        switch (_id) {\n");
             for (int propindex = 0; propindex < cdef->propertyList.size(); ++propindex) {
                 const PropertyDef &p = cdef->propertyList.at(propindex);
                 if (!p.user.endsWith(')'))
                     continue;
-                fprintf(out, "        case %d: *_b = %s; break;\n",
+                out->print("        case %d: *_b = %s; break;\n",
                          propindex, p.user.constData());
             }
-            fprintf(out, "        default: break;\n");
-            fprintf(out, "        }\n");
+            out->write("        default: break;\n");
+            out->write("        }\n");
         }
-        fprintf(out,
+        out->print(
                 "        _id -= %d;\n"
                 "    }", cdef->propertyList.count());
 
-        fprintf(out, "\n#endif // QT_NO_PROPERTIES");
+        out->write("\n#endif // QT_NO_PROPERTIES");
     }
     if (methodList.size() || cdef->signalList.size() || cdef->propertyList.size())
-        fprintf(out, "\n    ");
-    fprintf(out,"return _id;\n}\n");
+        out->write("\n    ");
+    out->write("return _id;\n}\n");
 }
 
 
@@ -1098,17 +1106,17 @@ QMap<int, QMultiMap<QByteArray, int> > Generator::methodsWithAutomaticTypesHelpe
 
 void Generator::generateStaticMetacall()
 {
-    fprintf(out, "void %s::qt_static_metacall(QObject *_o, QMetaObject::Call _c, int _id, void **_a)\n{\n",
+    out->print("void %s::qt_static_metacall(QObject *_o, QMetaObject::Call _c, int _id, void **_a)\n{\n",
             cdef->qualified.constData());
 
     bool needElse = false;
     bool isUsed_a = false;
 
     if (!cdef->constructorList.isEmpty()) {
-        fprintf(out, "    if (_c == QMetaObject::CreateInstance) {\n");
-        fprintf(out, "        switch (_id) {\n");
+        out->write("    if (_c == QMetaObject::CreateInstance) {\n");
+        out->write("        switch (_id) {\n");
         for (int ctorindex = 0; ctorindex < cdef->constructorList.count(); ++ctorindex) {
-            fprintf(out, "        case %d: { %s *_r = new %s(", ctorindex,
+            out->print("        case %d: { %s *_r = new %s(", ctorindex,
                     cdef->classname.constData(), cdef->classname.constData());
             const FunctionDef &f = cdef->constructorList.at(ctorindex);
             int offset = 1;
@@ -1117,21 +1125,21 @@ void Generator::generateStaticMetacall()
             for (int j = 0; j < argsCount; ++j) {
                 const ArgumentDef &a = f.arguments.at(j);
                 if (j)
-                    fprintf(out, ",");
-                fprintf(out, "(*reinterpret_cast< %s>(_a[%d]))", a.typeNameForCast.constData(), offset++);
+                    out->write(",");
+                out->print("(*reinterpret_cast< %s>(_a[%d]))", a.typeNameForCast.constData(), offset++);
             }
             if (f.isPrivateSignal) {
                 if (argsCount > 0)
-                    fprintf(out, ", ");
-                fprintf(out, "%s", QByteArray("QPrivateSignal()").constData());
+                    out->write(", ");
+                out->print("%s", QByteArray("QPrivateSignal()").constData());
             }
-            fprintf(out, ");\n");
-            fprintf(out, "            if (_a[0]) *reinterpret_cast<%s**>(_a[0]) = _r; } break;\n",
+            out->write(");\n");
+            out->print("            if (_a[0]) *reinterpret_cast<%s**>(_a[0]) = _r; } break;\n",
                     cdef->hasQGadget ? "void" : "QObject");
         }
-        fprintf(out, "        default: break;\n");
-        fprintf(out, "        }\n");
-        fprintf(out, "    }");
+        out->write("        default: break;\n");
+        out->write("        }\n");
+        out->write("    }");
         needElse = true;
         isUsed_a = true;
     }
@@ -1143,123 +1151,123 @@ void Generator::generateStaticMetacall()
 
     if (!methodList.isEmpty()) {
         if (needElse)
-            fprintf(out, " else ");
+            out->write(" else ");
         else
-            fprintf(out, "    ");
-        fprintf(out, "if (_c == QMetaObject::InvokeMetaMethod) {\n");
+            out->write("    ");
+        out->write("if (_c == QMetaObject::InvokeMetaMethod) {\n");
         if (cdef->hasQObject) {
 #ifndef QT_NO_DEBUG
-            fprintf(out, "        Q_ASSERT(staticMetaObject.cast(_o));\n");
+            out->write("        Q_ASSERT(staticMetaObject.cast(_o));\n");
 #endif
-            fprintf(out, "        %s *_t = static_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
+            out->print("        %s *_t = static_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
         } else {
-            fprintf(out, "        %s *_t = reinterpret_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
+            out->print("        %s *_t = reinterpret_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
         }
-        fprintf(out, "        Q_UNUSED(_t)\n");
-        fprintf(out, "        switch (_id) {\n");
+        out->write("        Q_UNUSED(_t)\n");
+        out->write("        switch (_id) {\n");
         for (int methodindex = 0; methodindex < methodList.size(); ++methodindex) {
             const FunctionDef &f = methodList.at(methodindex);
             Q_ASSERT(!f.normalizedType.isEmpty());
-            fprintf(out, "        case %d: ", methodindex);
+            out->print("        case %d: ", methodindex);
             if (f.normalizedType != "void")
-                fprintf(out, "{ %s _r = ", noRef(f.normalizedType).constData());
-            fprintf(out, "_t->");
+                out->print("{ %s _r = ", noRef(f.normalizedType).constData());
+            out->write("_t->");
             if (f.inPrivateClass.size())
-                fprintf(out, "%s->", f.inPrivateClass.constData());
-            fprintf(out, "%s(", f.name.constData());
+                out->print("%s->", f.inPrivateClass.constData());
+            out->print("%s(", f.name.constData());
             int offset = 1;
 
             int argsCount = f.arguments.count();
             for (int j = 0; j < argsCount; ++j) {
                 const ArgumentDef &a = f.arguments.at(j);
                 if (j)
-                    fprintf(out, ",");
-                fprintf(out, "(*reinterpret_cast< %s>(_a[%d]))",a.typeNameForCast.constData(), offset++);
+                    out->write(",");
+                out->print("(*reinterpret_cast< %s>(_a[%d]))",a.typeNameForCast.constData(), offset++);
                 isUsed_a = true;
             }
             if (f.isPrivateSignal) {
                 if (argsCount > 0)
-                    fprintf(out, ", ");
-                fprintf(out, "%s", "QPrivateSignal()");
+                    out->write(", ");
+                out->print("%s", "QPrivateSignal()");
             }
-            fprintf(out, ");");
+            out->write(");");
             if (f.normalizedType != "void") {
-                fprintf(out, "\n            if (_a[0]) *reinterpret_cast< %s*>(_a[0]) = _r; } ",
+                out->print("\n            if (_a[0]) *reinterpret_cast< %s*>(_a[0]) = _r; } ",
                         noRef(f.normalizedType).constData());
                 isUsed_a = true;
             }
-            fprintf(out, " break;\n");
+            out->write(" break;\n");
         }
-        fprintf(out, "        default: ;\n");
-        fprintf(out, "        }\n");
-        fprintf(out, "    }");
+        out->write("        default: ;\n");
+        out->write("        }\n");
+        out->write("    }");
         needElse = true;
 
         QMap<int, QMultiMap<QByteArray, int> > methodsWithAutomaticTypes = methodsWithAutomaticTypesHelper(methodList);
 
         if (!methodsWithAutomaticTypes.isEmpty()) {
-            fprintf(out, " else if (_c == QMetaObject::RegisterMethodArgumentMetaType) {\n");
-            fprintf(out, "        switch (_id) {\n");
-            fprintf(out, "        default: *reinterpret_cast<int*>(_a[0]) = -1; break;\n");
+            out->write(" else if (_c == QMetaObject::RegisterMethodArgumentMetaType) {\n");
+            out->write("        switch (_id) {\n");
+            out->write("        default: *reinterpret_cast<int*>(_a[0]) = -1; break;\n");
             QMap<int, QMultiMap<QByteArray, int> >::const_iterator it = methodsWithAutomaticTypes.constBegin();
             const QMap<int, QMultiMap<QByteArray, int> >::const_iterator end = methodsWithAutomaticTypes.constEnd();
             for ( ; it != end; ++it) {
-                fprintf(out, "        case %d:\n", it.key());
-                fprintf(out, "            switch (*reinterpret_cast<int*>(_a[1])) {\n");
-                fprintf(out, "            default: *reinterpret_cast<int*>(_a[0]) = -1; break;\n");
+                out->print("        case %d:\n", it.key());
+                out->write("            switch (*reinterpret_cast<int*>(_a[1])) {\n");
+                out->write("            default: *reinterpret_cast<int*>(_a[0]) = -1; break;\n");
                 foreach (const QByteArray &key, it->uniqueKeys()) {
                     foreach (int argumentID, it->values(key))
-                        fprintf(out, "            case %d:\n", argumentID);
-                    fprintf(out, "                *reinterpret_cast<int*>(_a[0]) = qRegisterMetaType< %s >(); break;\n", key.constData());
+                        out->print("            case %d:\n", argumentID);
+                    out->print("                *reinterpret_cast<int*>(_a[0]) = qRegisterMetaType< %s >(); break;\n", key.constData());
                 }
-                fprintf(out, "            }\n");
-                fprintf(out, "            break;\n");
+                out->write("            }\n");
+                out->write("            break;\n");
             }
-            fprintf(out, "        }\n");
-            fprintf(out, "    }");
+            out->write("        }\n");
+            out->write("    }");
             isUsed_a = true;
         }
 
     }
     if (!cdef->signalList.isEmpty()) {
         Q_ASSERT(needElse); // if there is signal, there was method.
-        fprintf(out, " else if (_c == QMetaObject::IndexOfMethod) {\n");
-        fprintf(out, "        int *result = reinterpret_cast<int *>(_a[0]);\n");
-        fprintf(out, "        void **func = reinterpret_cast<void **>(_a[1]);\n");
+        out->write(" else if (_c == QMetaObject::IndexOfMethod) {\n");
+        out->write("        int *result = reinterpret_cast<int *>(_a[0]);\n");
+        out->write("        void **func = reinterpret_cast<void **>(_a[1]);\n");
         bool anythingUsed = false;
         for (int methodindex = 0; methodindex < cdef->signalList.size(); ++methodindex) {
             const FunctionDef &f = cdef->signalList.at(methodindex);
             if (f.wasCloned || !f.inPrivateClass.isEmpty() || f.isStatic)
                 continue;
             anythingUsed = true;
-            fprintf(out, "        {\n");
-            fprintf(out, "            typedef %s (%s::*_t)(",f.type.rawName.constData() , cdef->classname.constData());
+            out->write("        {\n");
+            out->print("            typedef %s (%s::*_t)(",f.type.rawName.constData() , cdef->classname.constData());
 
             int argsCount = f.arguments.count();
             for (int j = 0; j < argsCount; ++j) {
                 const ArgumentDef &a = f.arguments.at(j);
                 if (j)
-                    fprintf(out, ", ");
-                fprintf(out, "%s", QByteArray(a.type.name + ' ' + a.rightType).constData());
+                    out->write(", ");
+                out->print("%s", QByteArray(a.type.name + ' ' + a.rightType).constData());
             }
             if (f.isPrivateSignal) {
                 if (argsCount > 0)
-                    fprintf(out, ", ");
-                fprintf(out, "%s", "QPrivateSignal");
+                    out->write(", ");
+                out->print("%s", "QPrivateSignal");
             }
             if (f.isConst)
-                fprintf(out, ") const;\n");
+                out->write(") const;\n");
             else
-                fprintf(out, ");\n");
-            fprintf(out, "            if (*reinterpret_cast<_t *>(func) == static_cast<_t>(&%s::%s)) {\n",
+                out->write(");\n");
+            out->print("            if (*reinterpret_cast<_t *>(func) == static_cast<_t>(&%s::%s)) {\n",
                     cdef->classname.constData(), f.name.constData());
-            fprintf(out, "                *result = %d;\n", methodindex);
-            fprintf(out, "                return;\n");
-            fprintf(out, "            }\n        }\n");
+            out->print("                *result = %d;\n", methodindex);
+            out->write("                return;\n");
+            out->write("            }\n        }\n");
         }
         if (!anythingUsed)
-            fprintf(out, "        Q_UNUSED(result);\n        Q_UNUSED(func);\n");
-        fprintf(out, "    }");
+            out->write("        Q_UNUSED(result);\n        Q_UNUSED(func);\n");
+        out->write("    }");
         needElse = true;
     }
 
@@ -1267,19 +1275,19 @@ void Generator::generateStaticMetacall()
 
     if (!automaticPropertyMetaTypes.isEmpty()) {
         if (needElse)
-            fprintf(out, " else ");
+            out->write(" else ");
         else
-            fprintf(out, "    ");
-        fprintf(out, "if (_c == QMetaObject::RegisterPropertyMetaType) {\n");
-        fprintf(out, "        switch (_id) {\n");
-        fprintf(out, "        default: *reinterpret_cast<int*>(_a[0]) = -1; break;\n");
+            out->write("    ");
+        out->write("if (_c == QMetaObject::RegisterPropertyMetaType) {\n");
+        out->write("        switch (_id) {\n");
+        out->write("        default: *reinterpret_cast<int*>(_a[0]) = -1; break;\n");
         foreach (const QByteArray &key, automaticPropertyMetaTypes.uniqueKeys()) {
             foreach (int propertyID, automaticPropertyMetaTypes.values(key))
-                fprintf(out, "        case %d:\n", propertyID);
-            fprintf(out, "            *reinterpret_cast<int*>(_a[0]) = qRegisterMetaType< %s >(); break;\n", key.constData());
+                out->print("        case %d:\n", propertyID);
+            out->print("            *reinterpret_cast<int*>(_a[0]) = qRegisterMetaType< %s >(); break;\n", key.constData());
         }
-        fprintf(out, "        }\n");
-        fprintf(out, "    }\n");
+        out->write("        }\n");
+        out->write("    }\n");
         isUsed_a = true;
         needElse = true;
     }
@@ -1299,24 +1307,24 @@ void Generator::generateStaticMetacall()
             needSet |= !p.write.isEmpty() || (!p.member.isEmpty() && !p.constant);
             needReset |= !p.reset.isEmpty();
         }
-        fprintf(out, "\n#ifndef QT_NO_PROPERTIES\n    ");
+        out->write("\n#ifndef QT_NO_PROPERTIES\n    ");
 
         if (needElse)
-            fprintf(out, "else ");
-        fprintf(out, "if (_c == QMetaObject::ReadProperty) {\n");
+            out->write("else ");
+        out->write("if (_c == QMetaObject::ReadProperty) {\n");
         if (needGet) {
             if (cdef->hasQObject) {
 #ifndef QT_NO_DEBUG
-                fprintf(out, "        Q_ASSERT(staticMetaObject.cast(_o));\n");
+                out->write("        Q_ASSERT(staticMetaObject.cast(_o));\n");
 #endif
-                fprintf(out, "        %s *_t = static_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
+                out->print("        %s *_t = static_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
             } else {
-                fprintf(out, "        %s *_t = reinterpret_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
+                out->print("        %s *_t = reinterpret_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
             }
-            fprintf(out, "        Q_UNUSED(_t)\n");
+            out->write("        Q_UNUSED(_t)\n");
             if (needTempVarForGet)
-                fprintf(out, "        void *_v = _a[0];\n");
-            fprintf(out, "        switch (_id) {\n");
+                out->write("        void *_v = _a[0];\n");
+            out->write("        switch (_id) {\n");
             for (int propindex = 0; propindex < cdef->propertyList.size(); ++propindex) {
                 const PropertyDef &p = cdef->propertyList.at(propindex);
                 if (p.read.isEmpty() && p.member.isEmpty())
@@ -1326,42 +1334,42 @@ void Generator::generateStaticMetacall()
                     prefix += p.inPrivateClass + "->";
                 }
                 if (p.gspec == PropertyDef::PointerSpec)
-                    fprintf(out, "        case %d: _a[0] = const_cast<void*>(reinterpret_cast<const void*>(%s%s())); break;\n",
+                    out->print("        case %d: _a[0] = const_cast<void*>(reinterpret_cast<const void*>(%s%s())); break;\n",
                             propindex, prefix.constData(), p.read.constData());
                 else if (p.gspec == PropertyDef::ReferenceSpec)
-                    fprintf(out, "        case %d: _a[0] = const_cast<void*>(reinterpret_cast<const void*>(&%s%s())); break;\n",
+                    out->print("        case %d: _a[0] = const_cast<void*>(reinterpret_cast<const void*>(&%s%s())); break;\n",
                             propindex, prefix.constData(), p.read.constData());
                 else if (cdef->enumDeclarations.value(p.type, false))
-                    fprintf(out, "        case %d: *reinterpret_cast<int*>(_v) = QFlag(%s%s()); break;\n",
+                    out->print("        case %d: *reinterpret_cast<int*>(_v) = QFlag(%s%s()); break;\n",
                             propindex, prefix.constData(), p.read.constData());
                 else if (!p.read.isEmpty())
-                    fprintf(out, "        case %d: *reinterpret_cast< %s*>(_v) = %s%s(); break;\n",
+                    out->print("        case %d: *reinterpret_cast< %s*>(_v) = %s%s(); break;\n",
                             propindex, p.type.constData(), prefix.constData(), p.read.constData());
                 else
-                    fprintf(out, "        case %d: *reinterpret_cast< %s*>(_v) = %s%s; break;\n",
+                    out->print("        case %d: *reinterpret_cast< %s*>(_v) = %s%s; break;\n",
                             propindex, p.type.constData(), prefix.constData(), p.member.constData());
             }
-            fprintf(out, "        default: break;\n");
-            fprintf(out, "        }\n");
+            out->write("        default: break;\n");
+            out->write("        }\n");
         }
 
-        fprintf(out, "    }");
+        out->write("    }");
 
-        fprintf(out, " else ");
-        fprintf(out, "if (_c == QMetaObject::WriteProperty) {\n");
+        out->write(" else ");
+        out->write("if (_c == QMetaObject::WriteProperty) {\n");
 
         if (needSet) {
             if (cdef->hasQObject) {
 #ifndef QT_NO_DEBUG
-                fprintf(out, "        Q_ASSERT(staticMetaObject.cast(_o));\n");
+                out->write("        Q_ASSERT(staticMetaObject.cast(_o));\n");
 #endif
-                fprintf(out, "        %s *_t = static_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
+                out->print("        %s *_t = static_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
             } else {
-                fprintf(out, "        %s *_t = reinterpret_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
+                out->print("        %s *_t = reinterpret_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
             }
-            fprintf(out, "        Q_UNUSED(_t)\n");
-            fprintf(out, "        void *_v = _a[0];\n");
-            fprintf(out, "        switch (_id) {\n");
+            out->write("        Q_UNUSED(_t)\n");
+            out->write("        void *_v = _a[0];\n");
+            out->write("        switch (_id) {\n");
             for (int propindex = 0; propindex < cdef->propertyList.size(); ++propindex) {
                 const PropertyDef &p = cdef->propertyList.at(propindex);
                 if (p.constant)
@@ -1373,48 +1381,48 @@ void Generator::generateStaticMetacall()
                     prefix += p.inPrivateClass + "->";
                 }
                 if (cdef->enumDeclarations.value(p.type, false)) {
-                    fprintf(out, "        case %d: %s%s(QFlag(*reinterpret_cast<int*>(_v))); break;\n",
+                    out->print("        case %d: %s%s(QFlag(*reinterpret_cast<int*>(_v))); break;\n",
                             propindex, prefix.constData(), p.write.constData());
                 } else if (!p.write.isEmpty()) {
-                    fprintf(out, "        case %d: %s%s(*reinterpret_cast< %s*>(_v)); break;\n",
+                    out->print("        case %d: %s%s(*reinterpret_cast< %s*>(_v)); break;\n",
                             propindex, prefix.constData(), p.write.constData(), p.type.constData());
                 } else {
-                    fprintf(out, "        case %d:\n", propindex);
-                    fprintf(out, "            if (%s%s != *reinterpret_cast< %s*>(_v)) {\n",
+                    out->print("        case %d:\n", propindex);
+                    out->print("            if (%s%s != *reinterpret_cast< %s*>(_v)) {\n",
                             prefix.constData(), p.member.constData(), p.type.constData());
-                    fprintf(out, "                %s%s = *reinterpret_cast< %s*>(_v);\n",
+                    out->print("                %s%s = *reinterpret_cast< %s*>(_v);\n",
                             prefix.constData(), p.member.constData(), p.type.constData());
                     if (!p.notify.isEmpty() && p.notifyId != -1) {
                         const FunctionDef &f = cdef->signalList.at(p.notifyId);
                         if (f.arguments.size() == 0)
-                            fprintf(out, "                Q_EMIT _t->%s();\n", p.notify.constData());
+                            out->print("                Q_EMIT _t->%s();\n", p.notify.constData());
                         else if (f.arguments.size() == 1 && f.arguments.at(0).normalizedType == p.type)
-                            fprintf(out, "                Q_EMIT _t->%s(%s%s);\n",
+                            out->print("                Q_EMIT _t->%s(%s%s);\n",
                                     p.notify.constData(), prefix.constData(), p.member.constData());
                     }
-                    fprintf(out, "            }\n");
-                    fprintf(out, "            break;\n");
+                    out->write("            }\n");
+                    out->write("            break;\n");
                 }
             }
-            fprintf(out, "        default: break;\n");
-            fprintf(out, "        }\n");
+            out->write("        default: break;\n");
+            out->write("        }\n");
         }
 
-        fprintf(out, "    }");
+        out->write("    }");
 
-        fprintf(out, " else ");
-        fprintf(out, "if (_c == QMetaObject::ResetProperty) {\n");
+        out->write(" else ");
+        out->write("if (_c == QMetaObject::ResetProperty) {\n");
         if (needReset) {
             if (cdef->hasQObject) {
 #ifndef QT_NO_DEBUG
-                fprintf(out, "        Q_ASSERT(staticMetaObject.cast(_o));\n");
+                out->write("        Q_ASSERT(staticMetaObject.cast(_o));\n");
 #endif
-                fprintf(out, "        %s *_t = static_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
+                out->print("        %s *_t = static_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
             } else {
-                fprintf(out, "        %s *_t = reinterpret_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
+                out->print("        %s *_t = reinterpret_cast<%s *>(_o);\n", cdef->classname.constData(), cdef->classname.constData());
             }
-            fprintf(out, "        Q_UNUSED(_t)\n");
-            fprintf(out, "        switch (_id) {\n");
+            out->write("        Q_UNUSED(_t)\n");
+            out->write("        switch (_id) {\n");
             for (int propindex = 0; propindex < cdef->propertyList.size(); ++propindex) {
                 const PropertyDef &p = cdef->propertyList.at(propindex);
                 if (!p.reset.endsWith(')'))
@@ -1423,38 +1431,38 @@ void Generator::generateStaticMetacall()
                 if (p.inPrivateClass.size()) {
                     prefix += p.inPrivateClass + "->";
                 }
-                fprintf(out, "        case %d: %s%s; break;\n",
+                out->print("        case %d: %s%s; break;\n",
                         propindex, prefix.constData(), p.reset.constData());
             }
-            fprintf(out, "        default: break;\n");
-            fprintf(out, "        }\n");
+            out->write("        default: break;\n");
+            out->write("        }\n");
         }
-        fprintf(out, "    }");
-        fprintf(out, "\n#endif // QT_NO_PROPERTIES");
+        out->write("    }");
+        out->write("\n#endif // QT_NO_PROPERTIES");
         needElse = true;
     }
 
     if (needElse)
-        fprintf(out, "\n");
+        out->write("\n");
 
     if (methodList.isEmpty()) {
-        fprintf(out, "    Q_UNUSED(_o);\n");
+        out->write("    Q_UNUSED(_o);\n");
         if (cdef->constructorList.isEmpty() && automaticPropertyMetaTypes.isEmpty() && methodsWithAutomaticTypesHelper(methodList).isEmpty()) {
-            fprintf(out, "    Q_UNUSED(_id);\n");
-            fprintf(out, "    Q_UNUSED(_c);\n");
+            out->write("    Q_UNUSED(_id);\n");
+            out->write("    Q_UNUSED(_c);\n");
         }
     }
     if (!isUsed_a)
-        fprintf(out, "    Q_UNUSED(_a);\n");
+        out->write("    Q_UNUSED(_a);\n");
 
-    fprintf(out, "}\n\n");
+    out->write("}\n\n");
 }
 
 void Generator::generateSignal(FunctionDef *def,int index)
 {
     if (def->wasCloned || def->isAbstract)
         return;
-    fprintf(out, "\n// SIGNAL %d\n%s %s::%s(",
+    out->print("\n// SIGNAL %d\n%s %s::%s(",
             index, def->type.name.constData(), cdef->qualified.constData(), def->name.constData());
 
     QByteArray thisPtr = "this";
@@ -1470,9 +1478,9 @@ void Generator::generateSignal(FunctionDef *def,int index)
     Q_ASSERT(!def->normalizedType.isEmpty());
     if (def->arguments.isEmpty() && def->normalizedType == "void") {
         if (def->isPrivateSignal)
-            fprintf(out, "QPrivateSignal");
+            out->write("QPrivateSignal");
 
-        fprintf(out, ")%s\n{\n"
+        out->print(")%s\n{\n"
                 "    QMetaObject::activate(%s, &staticMetaObject, %d, Q_NULLPTR);\n"
                 "}\n", constQualifier, thisPtr.constData(), index);
         return;
@@ -1482,71 +1490,71 @@ void Generator::generateSignal(FunctionDef *def,int index)
     for (int j = 0; j < def->arguments.count(); ++j) {
         const ArgumentDef &a = def->arguments.at(j);
         if (j)
-            fprintf(out, ", ");
-        fprintf(out, "%s _t%d%s", a.type.name.constData(), offset++, a.rightType.constData());
+            out->write(", ");
+        out->print("%s _t%d%s", a.type.name.constData(), offset++, a.rightType.constData());
     }
     if (def->isPrivateSignal) {
         if (!def->arguments.isEmpty())
-            fprintf(out, ", ");
-        fprintf(out, "QPrivateSignal");
+            out->write(", ");
+        out->write("QPrivateSignal");
     }
 
-    fprintf(out, ")%s\n{\n", constQualifier);
+    out->print(")%s\n{\n", constQualifier);
     if (def->type.name.size() && def->normalizedType != "void") {
         QByteArray returnType = noRef(def->normalizedType);
         if (returnType.endsWith('*')) {
-            fprintf(out, "    %s _t0 = 0;\n", returnType.constData());
+            out->print("    %s _t0 = 0;\n", returnType.constData());
         } else {
-            fprintf(out, "    %s _t0 = %s();\n", returnType.constData(), returnType.constData());
+            out->print("    %s _t0 = %s();\n", returnType.constData(), returnType.constData());
         }
     }
 
-    fprintf(out, "    void *_a[] = { ");
+    out->write("    void *_a[] = { ");
     if (def->normalizedType == "void") {
-        fprintf(out, "Q_NULLPTR");
+        out->write("Q_NULLPTR");
     } else {
         if (def->returnTypeIsVolatile)
-             fprintf(out, "const_cast<void*>(reinterpret_cast<const volatile void*>(&_t0))");
+             out->write("const_cast<void*>(reinterpret_cast<const volatile void*>(&_t0))");
         else
-             fprintf(out, "const_cast<void*>(reinterpret_cast<const void*>(&_t0))");
+             out->write("const_cast<void*>(reinterpret_cast<const void*>(&_t0))");
     }
     int i;
     for (i = 1; i < offset; ++i)
         if (def->arguments.at(i - 1).type.isVolatile)
-            fprintf(out, ", const_cast<void*>(reinterpret_cast<const volatile void*>(&_t%d))", i);
+            out->print(", const_cast<void*>(reinterpret_cast<const volatile void*>(&_t%d))", i);
         else
-            fprintf(out, ", const_cast<void*>(reinterpret_cast<const void*>(&_t%d))", i);
-    fprintf(out, " };\n");
-    fprintf(out, "    QMetaObject::activate(%s, &staticMetaObject, %d, _a);\n", thisPtr.constData(), index);
+            out->print(", const_cast<void*>(reinterpret_cast<const void*>(&_t%d))", i);
+    out->write(" };\n");
+    out->print("    QMetaObject::activate(%s, &staticMetaObject, %d, _a);\n", thisPtr.constData(), index);
     if (def->normalizedType != "void")
-        fprintf(out, "    return _t0;\n");
-    fprintf(out, "}\n");
+        out->write("    return _t0;\n");
+    out->write("}\n");
 }
 
-static void writePluginMetaData(FILE *out, const QJsonObject &data)
+static void writePluginMetaData(OutputBuffer *out, const QJsonObject &data)
 {
     const QJsonDocument doc(data);
 
-    fputs("\nQT_PLUGIN_METADATA_SECTION\n"
-          "static const unsigned char qt_pluginMetaData[] = {\n"
-          "    'Q', 'T', 'M', 'E', 'T', 'A', 'D', 'A', 'T', 'A', ' ', ' ',\n   ", out);
+    out->write("\nQT_PLUGIN_METADATA_SECTION\n"
+               "static const unsigned char qt_pluginMetaData[] = {\n"
+               "    'Q', 'T', 'M', 'E', 'T', 'A', 'D', 'A', 'T', 'A', ' ', ' ',\n   ");
 #if 0
-    fprintf(out, "\"%s\";\n", doc.toJson().constData());
+    out->print("\"%s\";\n", doc.toJson().constData());
 #else
     const QByteArray binary = doc.toBinaryData();
     const int last = binary.size() - 1;
     for (int i = 0; i < last; ++i) {
         uchar c = (uchar)binary.at(i);
         if (c < 0x20 || c >= 0x7f)
-            fprintf(out, " 0x%02x,", c);
+            out->print(" 0x%02x,", c);
         else if (c == '\'' || c == '\\')
-            fprintf(out, " '\\%c',", c);
+            out->print(" '\\%c',", c);
         else
-            fprintf(out, " '%c', ", c);
+            out->print(" '%c', ", c);
         if (!((i + 1) % 8))
-            fputs("\n   ", out);
+            out->write("\n   ");
     }
-    fprintf(out, " 0x%02x\n};\n", (uchar)binary.at(last));
+    out->print(" 0x%02x\n};\n", (uchar)binary.at(last));
 #endif
 }
 
@@ -1570,24 +1578,205 @@ void Generator::generatePluginMetaData()
     foreach (const QString &key, cdef->pluginData.metaArgs.keys())
         data.insert(key, cdef->pluginData.metaArgs.value(key));
 
-    fputs("\nQT_PLUGIN_METADATA_SECTION const uint qt_section_alignment_dummy = 42;\n\n"
-          "#ifdef QT_NO_DEBUG\n", out);
+    out->write("\nQT_PLUGIN_METADATA_SECTION const uint qt_section_alignment_dummy = 42;\n\n"
+               "#ifdef QT_NO_DEBUG\n");
     writePluginMetaData(out, data);
 
-    fputs("\n#else // QT_NO_DEBUG\n", out);
+    out->write("\n#else // QT_NO_DEBUG\n");
 
     data.remove(debugKey);
     data.insert(debugKey, QJsonValue(true));
     writePluginMetaData(out, data);
 
-    fputs("#endif // QT_NO_DEBUG\n\n", out);
+    out->write("#endif // QT_NO_DEBUG\n\n");
 
     // 'Use' all namespaces.
     int pos = cdef->qualified.indexOf("::");
     for ( ; pos != -1 ; pos = cdef->qualified.indexOf("::", pos + 2) )
-        fprintf(out, "using namespace %s;\n", cdef->qualified.left(pos).constData());
-    fprintf(out, "QT_MOC_EXPORT_PLUGIN(%s, %s)\n\n",
+        out->print("using namespace %s;\n", cdef->qualified.left(pos).constData());
+    out->print("QT_MOC_EXPORT_PLUGIN(%s, %s)\n\n",
             cdef->qualified.constData(), cdef->classname.constData());
 }
 
+// The hash function of the generated name lookups, FNV-1a with a seed,
+// followed by the MurmurHash3 finalizer so that the low bits depend on
+// the seed too. Must give the same result as qt_moc_nameHash() in the
+// generated code.
+static quint32 nameHash(const QByteArray &name, quint32 seed)
+{
+    quint32 h = 2166136261u ^ seed;
+    for (int i = 0; i < name.size(); ++i) {
+        h ^= uchar(name.at(i));
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/*
+    Builds a minimal perfect hash of \a names in two levels: the hash with
+    \a seed picks one of names.size() buckets, and the bucket's entry in
+    \a displacements says where its names go. A negative entry -1 - slot
+    is the slot of the bucket's only name; otherwise it is the seed that
+    spreads the bucket's names over free slots. Buckets with most names
+    are placed first, while most slots are still free. \a nameAtSlot maps
+    each slot to an index in \a names. Fails if a bucket finds no seed.
+*/
+static bool nameHashTable(const QList<QByteArray> &names, quint32 seed,
+                          QVector<int> *displacements, QVector<int> *nameAtSlot)
+{
+    const int size = names.size();
+    QVector<QList<int> > buckets(size);
+    for (int i = 0; i < size; ++i)
+        buckets[nameHash(names.at(i), seed) % size] += i;
+    // (-bucket size, bucket), so that sorting puts the largest first
+    QVector<QPair<int, int> > order;
+    for (int b = 0; b < size; ++b)
+        order += qMakePair(-buckets.at(b).size(), b);
+    std::sort(order.begin(), order.end());
+
+    *displacements = QVector<int>(size, 0);
+    *nameAtSlot = QVector<int>(size, -1);
+    int freeSlot = 0;
+    for (int o = 0; o < size; ++o) {
+        const QList<int> &bucket = buckets.at(order.at(o).second);
+        int &displacement = (*displacements)[order.at(o).second];
+        if (bucket.isEmpty())
+            break;
+        if (bucket.size() == 1) {
+            while ((*nameAtSlot)[freeSlot] >= 0)
+                ++freeSlot;
+            (*nameAtSlot)[freeSlot] = bucket.first();
+            displacement = -1 - freeSlot;
+            continue;
+        }
+        QVector<int> bucketSlots(bucket.size());
+        for (displacement = 0; displacement <= SHRT_MAX; ++displacement) {
+            bool collision = false;
+            for (int i = 0; i < bucket.size() && !collision; ++i) {
+                bucketSlots[i] = nameHash(names.at(bucket.at(i)), displacement) % size;
+                collision = nameAtSlot->at(bucketSlots.at(i)) >= 0
+                        || std::find(bucketSlots.constBegin(), bucketSlots.constBegin() + i, bucketSlots.at(i))
+                           != bucketSlots.constBegin() + i;
+            }
+            if (!collision)
+                break;
+        }
+        if (displacement > SHRT_MAX)
+            return false;
+        for (int i = 0; i < bucket.size(); ++i)
+            (*nameAtSlot)[bucketSlots.at(i)] = bucket.at(i);
+    }
+    return true;
+}
+
+/*
+    For --name-index: overloads of qt_moc_indexOfMethod(),
+    qt_moc_indexOfProperty() and qt_moc_indexOfEnumerator() that take a
+    pointer to the class, so that a call on an object picks the lookups
+    of its class, or of the nearest base class that has them. They are
+    declared in a block of their own, which code calling them copies.
+*/
+void Generator::generateNameIndexes()
+{
+    const char *className = cdef->qualified.constData();
+    out->print("// name lookups of %s, generated by moc --name-index; to call them, declare\n"
+               "int qt_moc_indexOfMethod(const %s *, const char *signature);\n"
+               "int qt_moc_indexOfProperty(const %s *, const char *name);\n"
+               "int qt_moc_indexOfEnumerator(const %s *, const char *name);\n\n",
+               className, className, className, className);
+
+    out->write("#ifndef QT_MOC_NAME_HASH\n"
+               "#define QT_MOC_NAME_HASH\n"
+               "static inline uint qt_moc_nameHash(const char *name, uint seed)\n{\n"
+               "    uint h = 2166136261u ^ seed;\n"
+               "    while (*name) {\n"
+               "        h ^= uchar(*name++);\n"
+               "        h *= 16777619u;\n"
+               "    }\n"
+               "    h ^= h >> 16;\n"
+               "    h *= 0x85ebca6bu;\n"
+               "    h ^= h >> 13;\n"
+               "    h *= 0xc2b2ae35u;\n"
+               "    h ^= h >> 16;\n"
+               "    return h;\n"
+               "}\n"
+               "#endif\n\n");
+
+    // local method indexes are in the order of the method data:
+    // signals, slots, then other invokables
+    QList<QByteArray> methods;
+    const QList<FunctionDef> *lists[] = { &cdef->signalList, &cdef->slotList, &cdef->methodList };
+    for (int l = 0; l < 3; ++l) {
+        for (int i = 0; i < lists[l]->size(); ++i) {
+            const FunctionDef &f = lists[l]->at(i);
+            QByteArray signature = f.name + '(';
+            for (int j = 0; j < f.arguments.size(); ++j) {
+                if (j)
+                    signature += ',';
+                signature += f.arguments.at(j).normalizedType;
+            }
+            signature += ')';
+            methods += signature;
+        }
+    }
+    QList<QByteArray> properties;
+    for (int i = 0; i < cdef->propertyList.size(); ++i)
+        properties += cdef->propertyList.at(i).name;
+    QList<QByteArray> enumerators;
+    for (int i = 0; i < cdef->enumList.size(); ++i)
+        enumerators += cdef->enumList.at(i).name;
+
+    generateNameLookup("Method", methods, "methodOffset");
+    generateNameLookup("Property", properties, "propertyOffset");
+    generateNameLookup("Enumerator", enumerators, "enumeratorOffset");
+}
+
+void Generator::generateNameLookup(const char *kind, const QList<QByteArray> &names, const char *offsetFunction)
+{
+    out->print("int qt_moc_indexOf%s(const %s *, const char *name)\n{\n", kind, cdef->qualified.constData());
+    if (names.isEmpty()) {
+        out->write("    Q_UNUSED(name);\n    return -1;\n}\n\n");
+        return;
+    }
+
+    // Like QMetaObject, prefer the last of several members with the same name
+    QList<QByteArray> uniqueNames;
+    QList<int> indexes;
+    QHash<QByteArray, int> seen;
+    for (int i = names.size() - 1; i >= 0; --i) {
+        if (seen.contains(names.at(i)))
+            continue;
+        seen.insert(names.at(i), i);
+        uniqueNames.prepend(names.at(i));
+        indexes.prepend(i);
+    }
+
+    quint32 seed = 0;
+    QVector<int> displacements, nameAtSlot;
+    while (!nameHashTable(uniqueNames, seed, &displacements, &nameAtSlot))
+        ++seed;
+
+    out->write("    static const char * const names[] = {");
+    for (int i = 0; i < nameAtSlot.size(); ++i)
+        out->print("%s\n        \"%s\"", i ? "," : "", uniqueNames.at(nameAtSlot.at(i)).constData());
+    out->write("\n    };\n    static const short indexes[] = {");
+    for (int i = 0; i < nameAtSlot.size(); ++i)
+        out->print("%s%s%d", i ? "," : "", i % 16 ? " " : "\n        ", indexes.at(nameAtSlot.at(i)));
+    out->write("\n    };\n    static const short displacements[] = {");
+    for (int i = 0; i < displacements.size(); ++i)
+        out->print("%s%s%d", i ? "," : "", i % 16 ? " " : "\n        ", displacements.at(i));
+    out->write("\n    };\n");
+    out->print("    const int displacement = displacements[qt_moc_nameHash(name, %uu) %% %du];\n", seed, nameAtSlot.size());
+    out->print("    const int slot = displacement < 0 ? -1 - displacement\n"
+               "            : int(qt_moc_nameHash(name, uint(displacement)) %% %du);\n", nameAtSlot.size());
+    out->print("    if (strcmp(names[slot], name))\n"
+               "        return -1;\n"
+               "    return %s::staticMetaObject.%s() + indexes[slot];\n}\n\n", cdef->qualified.constData(), offsetFunction);
+}
+
 QT_END_NAMESPACE
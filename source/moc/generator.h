@@ -40,12 +40,14 @@ QT_BEGIN_NAMESPACE
 
 class Generator
 {
-    FILE *out;
+    OutputBuffer *out;
     ClassDef *cdef;
     QVector<uint> meta_data;
 public:
-    Generator(ClassDef *classDef, const QList<QByteArray> &metaTypes, const QHash<QByteArray, QByteArray> &knownQObjectClasses, const QHash<QByteArray, QByteArray> &knownGadgets, FILE *outfile = 0);
+    Generator(ClassDef *classDef, const QList<QByteArray> &metaTypes, const QHash<QByteArray, QByteArray> &knownQObjectClasses, const QHash<QByteArray, QByteArray> &knownGadgets, OutputBuffer *outfile = 0);
     void generateCode();
+    // emit perfect hash lookups of method, property and enumerator names
+    bool generateNameIndex;
 private:
     bool registerableMetaType(const QByteArray &propertyType);
     void registerClassInfoStrings();
@@ -63,12 +65,15 @@ private:
     void generateStaticMetacall();
     void generateSignal(FunctionDef *def, int index);
     void generatePluginMetaData();
+    void generateNameIndexes();
+    void generateNameLookup(const char *kind, const QList<QByteArray> &names, const char *offsetFunction);
     QMultiMap<QByteArray, int> automaticPropertyMetaTypesHelper();
     QMap<int, QMultiMap<QByteArray, int> > methodsWithAutomaticTypesHelper(const QList<FunctionDef> &methodList);
 
     void strreg(const QByteArray &); // registers a string
     int stridx(const QByteArray &); // returns a string's id
-    QList<QByteArray> strings;
+    QList<QByteArray> strings; // in registration order
+    QHash<QByteArray, int> stringIndexes; // string -> index in strings
     QByteArray purestSuperClass;
     QList<QByteArray> metaTypes;
     QHash<QByteArray, QByteArray> knownQObjectClasses;
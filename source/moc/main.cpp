@@ -34,13 +34,34 @@
 #include "preprocessor.h"
 #include "moc.h"
 #include "outputrevision.h"
+#include "cache.h"
+#include "scanner.h"
+#include "mocstate.h"
 
 #include <qfile.h>
 #include <qfileinfo.h>
 #include <qdir.h>
+#include <qdatetime.h>
+#include <qcryptographichash.h>
+#include <qatomic.h>
+#include <qscopedpointer.h>
+#include <qrunnable.h>
+#include <qthread.h>
+#include <qthreadpool.h>
+#include <qwaitcondition.h>
+#include <qdatastream.h>
+#include <qlocalserver.h>
+#include <qlocalsocket.h>
+#include <qelapsedtimer.h>
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#if defined(Q_OS_UNIX)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 #include <qcoreapplication.h>
 #include <qcommandlineoption.h>
@@ -78,7 +99,7 @@ static QByteArray combinePath(const QString &infile, const QString &outfile)
 void error(const char *msg = "Invalid argument")
 {
     if (msg)
-        fprintf(stderr, "moc: %s\n", msg);
+        printMessage("moc: %s\n", msg);
 }
 
 
@@ -172,14 +193,684 @@ static QStringList argumentsFromCommandLineAndFile(const QStringList &arguments)
     return allArguments;
 }
 
+static FILE *openOutputFile(const QString &output)
+{
+    FILE *out = 0;
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+    if (fopen_s(&out, QFile::encodeName(output).constData(), "w"))
+        out = 0;
+#else
+    out = fopen(QFile::encodeName(output).constData(), "w"); // create output file
+#endif
+    if (!out)
+        printMessage("moc: Cannot create %s\n", QFile::encodeName(output).constData());
+    return out;
+}
 
-int runMoc(int argc, char **argv)
+static bool writeOutput(const QString &output, const QByteArray &data)
 {
-    QCoreApplication app(argc, argv);
-    QCoreApplication::setApplicationVersion(QString::fromLatin1(QT_VERSION_STR));
+    if (output.isEmpty()) {
+        writeStandardOutput(data);
+        return true;
+    }
+    FILE *out = openOutputFile(output);
+    if (!out)
+        return false;
+    fwrite(data.constData(), 1, data.size(), out);
+    fclose(out);
+    return true;
+}
+
+// the file was written by writeOutput() with the same content
+static bool outputUnchanged(const QString &output, const QByteArray &data)
+{
+    QFile file(output);
+    qint64 expectedSize = data.size();
+#ifdef Q_OS_WIN
+    expectedSize += data.count('\n'); // written in text mode
+#endif
+    if (file.size() != expectedSize || !file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    return file.readAll() == data;
+}
+
+/*
+    The part of the result cache key that is the same for all input files:
+    the moc output revision, the working directory (relative include
+    paths) and the values of all options that change the generated code.
+ */
+static QByteArray cacheFingerprint(const QCommandLineParser &parser, const QList<QCommandLineOption> &options)
+{
+    QByteArray fingerprint;
+    fingerprint += "moc " + QByteArray::number(mocOutputRevision) + ' ' + QT_VERSION_STR + '\n';
+    fingerprint += QFile::encodeName(QDir::currentPath()) + '\n';
+    foreach (const QCommandLineOption &option, options) {
+        if (!parser.isSet(option))
+            continue;
+        fingerprint += '-' + option.names().first().toUtf8() + '\n';
+        foreach (const QString &value, parser.values(option))
+            fingerprint += value.toUtf8() + '\n';
+    }
+    return fingerprint;
+}
+
+// the output file is part of the key, it determines the generated #include
+static QByteArray cacheKey(const QByteArray &fingerprint, const QString &filename, const QString &output)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(fingerprint);
+    hash.addData(QFile::encodeName(QFileInfo(filename).canonicalFilePath()) + '\n');
+    hash.addData(QFile::encodeName(output) + '\n');
+    return hash.result().toHex();
+}
+
+// all files the result of a moc run depends on: the input, its includes and plugin meta data files
+static QList<QByteArray> dependencyFiles(const QByteArray &filename, const Preprocessor &pp, const Moc &moc)
+{
+    QList<QByteArray> includes = pp.preprocessedIncludes.toList();
+    std::sort(includes.begin(), includes.end());
+    QList<QByteArray> files;
+    files << QFile::encodeName(QFileInfo(QString::fromLocal8Bit(filename.constData())).canonicalFilePath());
+    files << includes;
+    files << moc.pluginMetaDataFiles;
+    return files;
+}
+
+// false if one of the dependencies changed during the run
+static bool cacheDependencies(const QList<QByteArray> &files, qint64 startTime,
+                              QList<MocCache::Dependency> *dependencies)
+{
+    foreach (const QByteArray &file, files) {
+        MocCache::Dependency dep;
+        if (!MocCache::dependencyFromFile(file, &dep) || dep.lastModified >= startTime)
+            return false;
+        dependencies->append(dep);
+    }
+    return true;
+}
+
+// spaces, '#' and '$' are special in make rules; ninja understands the same escapes
+static QByteArray escapeDependencyPath(const QByteArray &path)
+{
+    QByteArray escaped;
+    escaped.reserve(path.size());
+    for (int i = 0; i < path.size(); ++i) {
+        const char c = path.at(i);
+        if (c == ' ' || c == '#')
+            escaped += '\\';
+        else if (c == '$')
+            escaped += '$';
+        escaped += c;
+    }
+    return escaped;
+}
+
+static bool writeDependencyFile(const QString &path, const QByteArray &target, const QList<QByteArray> &dependencies)
+{
+    QByteArray rule = escapeDependencyPath(target) + ':';
+    foreach (const QByteArray &dependency, dependencies)
+        rule += " \\\n  " + escapeDependencyPath(dependency);
+    rule += '\n';
+    return writeOutput(path, rule);
+}
+
+// Settings that apply to every input file of a moc run
+struct MocSettings
+{
+    MocSettings()
+        : autoInclude(true), defaultInclude(true), cache(0), writeDependencyFile(false), unchangedOutputs(0),
+          timeReport(0), pipeline(false) {}
+    bool autoInclude;
+    bool defaultInclude;
+    MocCache *cache;
+    QByteArray cacheFingerprint;
+    bool writeDependencyFile;
+    // if empty, <output>.d and the output file
+    QString dependencyFilePath;
+    QByteArray dependencyRuleName;
+    // set for --write-if-changed: counts the output files left untouched
+    QAtomicInt *unchangedOutputs;
+    // set for --time-report: the report of the whole run
+    TimeReport *timeReport;
+    // --pipeline: preprocess on a second thread, see pipelinedTokens()
+    bool pipeline;
+};
+
+static bool writeGeneratedOutput(const MocSettings &settings, const QString &output, const QByteArray &data)
+{
+    if (settings.unchangedOutputs && output.size() && outputUnchanged(output, data)) {
+        settings.unchangedOutputs->ref();
+        return true;
+    }
+    return writeOutput(output, data);
+}
+
+// passes on what was collected in output to the output of the calling thread
+static void forwardOutput(const RequestOutput &output)
+{
+    if (output.err.size())
+        printMessage("%s", output.err.data().constData());
+    if (output.out.size())
+        writeStandardOutput(output.out.data());
+}
+
+/*
+    Runs Preprocessor::preprocessed() for pipelinedTokens(). Messages are
+    collected and a fatal error ends only the thread; pipelinedTokens()
+    passes both on after the thread has finished.
+ */
+class PreprocessorThread : public QThread
+{
+public:
+    PreprocessorThread(Preprocessor *pp, const QByteArray &filename, QFile *in)
+        : pp(pp), filename(filename), in(in), exitCode(-1) {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+        setCurrentRequestOutput(&output);
+        try {
+            pp->preprocessed(filename, in);
+        } catch (const RequestExit &requestExit) {
+            exitCode = requestExit.code;
+        }
+        setCurrentRequestOutput(0);
+        pp->output->close();
+    }
+
+    Preprocessor *pp;
+    QByteArray filename;
+    QFile *in;
+    RequestOutput output;
+    int exitCode; // -1 unless the preprocessor ended with a fatal error
+};
+
+/*
+    Preprocesses on a second thread and builds the TokenBuffer for the
+    parser from the chunks it passes on, without function bodies of
+    included files. Only a few chunks exist as Symbols at a time, instead
+    of the whole token stream of the input and its includes.
+ */
+static TokenBuffer pipelinedTokens(Preprocessor &pp, const QByteArray &filename, QFile *in)
+{
+    SymbolQueue queue(4);
+    pp.output = &queue;
+    PreprocessorThread thread(&pp, filename, in);
+    thread.start();
+
+    TokenBuffer tokens;
+    IncludedBodyFilter filter;
+    Symbols chunk, kept;
+    while (queue.pop(&chunk)) {
+        kept.clear();
+        filter.filter(chunk, &kept);
+        tokens.append(kept);
+    }
+    thread.wait();
+    pp.output = 0;
+    // the parser has printed nothing yet, so the messages keep their order
+    forwardOutput(thread.output);
+    if (thread.exitCode >= 0)
+        exitMoc(thread.exitCode);
+    return tokens;
+}
+
+/*
+    The steps of processFile() between the cache lookup and writing the
+    output: preprocesses, parses and generates the code into out.
+ */
+static void generateOutput(Preprocessor &pp, Moc &moc, const MocSettings &settings, QFile *in,
+                           TimeReport *timeReport, OutputBuffer *out)
+{
+    // 1. preprocess
+    const bool pipeline = settings.pipeline && !pp.preprocessOnly;
+    Symbols preprocessed;
+    if (pipeline)
+        moc.symbols = pipelinedTokens(pp, moc.filename, in);
+    else
+        preprocessed = pp.preprocessed(moc.filename, in);
+
+    if (!pp.preprocessOnly) {
+        // 2. parse, from the compact form of the token stream
+        PhaseTimer timer(timeReport, TimeReport::Parse);
+        if (!pipeline) {
+            moc.symbols = TokenBuffer(preprocessed);
+            preprocessed.clear();
+        }
+        moc.parse();
+        timer.addTokens(moc.symbols.size());
+    }
+
+    // 3. and output meta object code, collected in memory and written
+    // with a single write, so a failed run leaves no partial output file
+    if (pp.preprocessOnly) {
+        out->write(composePreprocessorOutput(preprocessed));
+        out->write('\n');
+    } else {
+        if (moc.classList.isEmpty()) {
+            moc.note("No relevant classes found. No output generated.");
+        } else {
+            PhaseTimer timer(timeReport, TimeReport::Generate);
+            moc.generate(out);
+            timer.addBytes(out->size());
+        }
+    }
+}
+
+/*
+    Runs moc on one input file. pp and moc are copies of the instances
+    set up from the command line; in a batch run the Preprocessors share
+    their PreprocessorCache. If generated is set, the output is returned
+    there instead of being written to output. If timeReport is set, the
+    time spent in each phase is added to it.
+ */
+static int processFile(Preprocessor pp, Moc moc, const MocSettings &settings,
+                       QString filename, const QString &output, QByteArray *generated = 0,
+                       TimeReport *timeReport = 0)
+{
+    QFile in;
+    pp.timeReport = timeReport;
+    moc.timeReport = timeReport;
+    if (timeReport)
+        ++timeReport->inputFiles;
+
+    if (settings.autoInclude) {
+        int spos = filename.lastIndexOf(QDir::separator());
+        int ppos = filename.lastIndexOf(QLatin1Char('.'));
+        // spos >= -1 && ppos > spos => ppos >= 0
+        moc.noInclude = (ppos > spos && filename[ppos + 1].toLower() != QLatin1Char('h'));
+    }
+    if (settings.defaultInclude) {
+        if (moc.includePath.isEmpty()) {
+            if (filename.size()) {
+                if (output.size())
+                    moc.includeFiles.append(combinePath(filename, output));
+                else
+                    moc.includeFiles.append(QFile::encodeName(filename));
+            }
+        } else {
+            moc.includeFiles.append(combinePath(filename, filename));
+        }
+    }
+
+    if (filename.isEmpty()) {
+        filename = QStringLiteral("standard input");
+        in.open(stdin, QIODevice::ReadOnly);
+    } else {
+        in.setFileName(filename);
+        if (!in.open(QIODevice::ReadOnly)) {
+            printMessage("moc: %s: No such file\n", qPrintable(filename));
+            return 1;
+        }
+        moc.filename = filename.toLocal8Bit();
+    }
+
+    MocCache *cache = moc.filename.size() ? settings.cache : 0;
+    QByteArray key;
+    const qint64 startTime = QDateTime::currentDateTime().toMSecsSinceEpoch();
+    const QString dependencyFilePath = settings.dependencyFilePath.isEmpty()
+            ? output + QStringLiteral(".d") : settings.dependencyFilePath;
+    const QByteArray dependencyRuleName = settings.dependencyRuleName.isEmpty()
+            ? QFile::encodeName(output) : settings.dependencyRuleName;
+    if (cache) {
+        key = cacheKey(settings.cacheFingerprint, filename, output);
+        QByteArray cached, cachedMessages;
+        QList<QByteArray> dependencies;
+        if (cache->lookup(key, &cached, &cachedMessages, &dependencies)) {
+            cache->recordResult(true);
+            if (!cachedMessages.isEmpty())
+                printMessage("%s", cachedMessages.constData());
+            if (settings.writeDependencyFile
+                && !writeDependencyFile(dependencyFilePath, dependencyRuleName, dependencies))
+                return 1;
+            if (generated) {
+                *generated = cached;
+                return 0;
+            }
+            return writeGeneratedOutput(settings, output, cached) ? 0 : 1;
+        }
+    }
+
+    moc.currentFilenames.push(filename.toLocal8Bit());
+    moc.includes = pp.includes;
+
+    // with a cache, the warnings and notes are stored with the output,
+    // to be printed again on a hit
+    OutputBuffer out;
+    QByteArray messages;
+    if (cache) {
+        RequestOutput collected;
+        RequestOutput *outerOutput = currentRequestOutput();
+        setCurrentRequestOutput(&collected);
+        int exitCode = -1;
+        try {
+            generateOutput(pp, moc, settings, &in, timeReport, &out);
+        } catch (const RequestExit &requestExit) {
+            exitCode = requestExit.code;
+        }
+        setCurrentRequestOutput(outerOutput);
+        forwardOutput(collected);
+        if (exitCode >= 0)
+            exitMoc(exitCode);
+        messages = collected.err.data();
+    } else {
+        generateOutput(pp, moc, settings, &in, timeReport, &out);
+    }
+
+    if (cache) {
+        QList<MocCache::Dependency> dependencies;
+        if (cacheDependencies(dependencyFiles(moc.filename, pp, moc), startTime, &dependencies))
+            cache->store(key, dependencies, out.data(), messages);
+        cache->recordResult(false);
+    }
+    if (generated)
+        *generated = out.data();
+    else if (!writeGeneratedOutput(settings, output, out.data()))
+        return 1;
+
+    if (settings.writeDependencyFile
+        && !writeDependencyFile(dependencyFilePath, dependencyRuleName, dependencyFiles(moc.filename, pp, moc)))
+        return 1;
+
+    return 0;
+}
+
+/*
+    One input file of a batch run. What the job writes to stdout and
+    stderr is collected, and a fatal error ends only the job, so that it
+    does not end the process while other jobs are running; processBatch()
+    passes both on once all jobs are done.
+ */
+struct MocJob : public QRunnable
+{
+    MocJob(const Preprocessor &pp, const Moc &moc, const MocSettings &settings,
+           const QString &filename, const QString &output)
+        : pp(pp), moc(moc), settings(settings), filename(filename), output(output),
+          result(1), exited(false)
+    { setAutoDelete(false); }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        RequestOutput *previousOutput = currentRequestOutput();
+        setCurrentRequestOutput(&requestOutput);
+        try {
+            result = processFile(pp, moc, settings, filename, output, &generated,
+                                 settings.timeReport ? &timeReport : 0);
+        } catch (const RequestExit &requestExit) {
+            result = requestExit.code;
+            exited = true;
+        }
+        setCurrentRequestOutput(previousOutput);
+    }
+
+    const Preprocessor &pp;
+    const Moc &moc;
+    const MocSettings &settings;
+    QString filename;
+    QString output;
+    RequestOutput requestOutput;
+    QByteArray generated;
+    TimeReport timeReport;
+    int result;
+    bool exited;
+};
+
+/*
+    Joins the code generated for several headers into one translation
+    unit. Each part keeps its banner and revision check, but #include
+    lines that an earlier part already has are left out. The static
+    symbols of each class are named after the class already, only the
+    plugin meta data of two parts would clash.
+ */
+static bool combineGeneratedCode(const QStringList &files, const QList<QByteArray> &parts, QByteArray *combined)
+{
+    QSet<QByteArray> includes;
+    int pluginPart = -1;
+    for (int i = 0; i < parts.size(); ++i) {
+        const QByteArray &part = parts.at(i);
+        if (part.contains("\nQT_MOC_EXPORT_PLUGIN(")) {
+            if (pluginPart >= 0) {
+                printMessage("moc: %s and %s both declare Q_PLUGIN_METADATA, they cannot be combined\n",
+                             qPrintable(files.at(pluginPart)), qPrintable(files.at(i)));
+                return false;
+            }
+            pluginPart = i;
+        }
+        int body = part.indexOf("\nQT_BEGIN_MOC_NAMESPACE\n");
+        if (body < 0)
+            body = part.size();
+        int from = 0;
+        while (from < body) {
+            int to = part.indexOf('\n', from);
+            if (to < 0)
+                to = part.size();
+            const QByteArray line = part.mid(from, to + 1 - from);
+            if (!line.startsWith("#include ") || !includes.contains(line)) {
+                includes.insert(line);
+                *combined += line;
+            }
+            from = to + 1;
+        }
+        *combined += part.mid(from);
+    }
+    return true;
+}
+
+/*
+    batch mode: header/output pairs, the include and tokenizer caches are
+    shared. If combinedOutput is set, the code of all headers is written
+    there instead.
+ */
+static int processBatch(const Preprocessor &pp, const Moc &moc, const MocSettings &settings,
+                        const QStringList &files, const QStringList &outputs, int jobCount,
+                        const QString &combinedOutput = QString())
+{
+    QList<MocJob *> jobs;
+    for (int i = 0; i < files.count(); ++i) {
+        const QString output = combinedOutput.isEmpty() ? outputs.at(i) : combinedOutput;
+        jobs.append(new MocJob(pp, moc, settings, files.at(i), output));
+    }
+
+    if (jobCount == 1) {
+        foreach (MocJob *job, jobs)
+            job->run();
+    } else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(jobCount);
+        foreach (MocJob *job, jobs)
+            pool.start(job);
+        pool.waitForDone();
+    }
+
+    // the messages in input order; a fatal error in any job ends the run
+    // without writing outputs, as it would for a single input file
+    int exitCode = -1;
+    foreach (MocJob *job, jobs) {
+        forwardOutput(job->requestOutput);
+        if (job->exited && exitCode < 0)
+            exitCode = job->result;
+    }
+    if (exitCode >= 0) {
+        qDeleteAll(jobs);
+        exitMoc(exitCode);
+    }
+
+    // write the results in input order, independent of the order the jobs finished in
+    int result = 0;
+    QList<QByteArray> parts;
+    foreach (MocJob *job, jobs) {
+        if (job->result != 0)
+            result = 1;
+        else if (combinedOutput.size())
+            parts += job->generated;
+        else if (!writeGeneratedOutput(settings, job->output, job->generated))
+            result = 1;
+        if (settings.timeReport)
+            settings.timeReport->merge(job->timeReport);
+    }
+    qDeleteAll(jobs);
+
+    if (combinedOutput.size() && result == 0) {
+        QByteArray combined;
+        if (!combineGeneratedCode(files, parts, &combined)
+            || !writeGeneratedOutput(settings, combinedOutput, combined))
+            result = 1;
+    }
+    return result;
+}
+
+/*
+    Preprocesses and parses filename as if it was included by an input
+    file, and saves the state it leaves behind, see mocstate.h.
+ */
+static int saveState(Preprocessor pp, Moc moc, const QString &filename, const QString &stateFile,
+                     const QByteArray &fingerprint)
+{
+    QFile in(filename);
+    if (!in.open(QIODevice::ReadOnly)) {
+        printMessage("moc: %s: No such file\n", qPrintable(filename));
+        return 1;
+    }
+    const QByteArray include = QFile::encodeName(QFileInfo(filename).canonicalFilePath());
+    pp.preprocessedIncludes.insert(include);
+    moc.filename = QFile::encodeName(filename);
+    moc.currentFilenames.push(moc.filename);
+    moc.includes = pp.includes;
+
+    Symbols preprocessed;
+    preprocessed += Symbol(0, MOC_INCLUDE_BEGIN, include);
+    preprocessed += pp.preprocessed(include, &in);
+    preprocessed += Symbol(0, MOC_INCLUDE_END, include);
+    moc.symbols = TokenBuffer(preprocessed);
+    moc.parse();
+
+    if (!saveMocState(stateFile, fingerprint, pp, moc)) {
+        printMessage("moc: Cannot write %s\n", qPrintable(stateFile));
+        return 1;
+    }
+    return 0;
+}
+
+// prints the files that contain a meta object macro
+static int scanFiles(const QStringList &files)
+{
+    int result = 0;
+    foreach (const QString &file, files) {
+        bool needsMoc;
+        if (!scanFile(file, &needsMoc)) {
+            printMessage("moc: %s: No such file\n", qPrintable(file));
+            result = 1;
+        } else if (needsMoc) {
+            writeStandardOutput(QFile::encodeName(file) + '\n');
+        }
+    }
+    return result;
+}
+
+/*
+    QCommandLineParser::process() and showHelp() end the process, which
+    a request of the moc server must not do.
+ */
+Q_NORETURN static void showHelp(QCommandLineParser &parser, int exitCode)
+{
+    if (!currentRequestOutput())
+        parser.showHelp(exitCode);
+    writeStandardOutput(parser.helpText().toLocal8Bit());
+    exitMoc(exitCode);
+}
+
+static void processArguments(QCommandLineParser &parser, const QStringList &arguments)
+{
+    if (!currentRequestOutput()) {
+        parser.process(arguments);
+        return;
+    }
+    if (!parser.parse(arguments)) {
+        printMessage("%s\n", qPrintable(parser.errorText()));
+        exitMoc(EXIT_FAILURE);
+    }
+    if (parser.isSet(QStringLiteral("version"))) {
+        writeStandardOutput((QCoreApplication::applicationName() + QLatin1Char(' ')
+                             + QCoreApplication::applicationVersion() + QLatin1Char('\n')).toLocal8Bit());
+        exitMoc(EXIT_SUCCESS);
+    }
+    if (parser.isSet(QStringLiteral("help")))
+        showHelp(parser, EXIT_SUCCESS);
+}
+
+/*
+    moc --server <name> keeps running and runs the command lines that
+    moc --client <name> sends it, so that a build does not start every
+    moc cold. Include lookups and tokenized include files stay cached
+    between requests, in one PreprocessorCache per working directory,
+    include path list and token cache. Tokenized files are checked
+    against the size and modification time of the file when used, and
+    include directories that changed are listed again.
+
+    Requests run concurrently. The working directory belongs to the
+    process, so requests from different directories take turns, in the
+    order they came: once a request waits for its directory, new requests
+    for the current one wait behind it.
 
-    bool autoInclude = true;
-    bool defaultInclude = true;
+    Only processes of the user the server runs as may connect. The
+    server ends on a request of moc --stop-server <name>, or when it has
+    been idle for the --idle-timeout.
+ */
+class MocServer : public QLocalServer
+{
+public:
+    MocServer()
+        : directoryState(DirectoryUnknown), requestsInDirectory(0), lastTurn(0), currentTurn(0), activeRequests(0)
+    { idleTimer.start(); }
+    ~MocServer() { pool.waitForDone(); qDeleteAll(caches); }
+
+    PreprocessorCache *preprocessorCache(const Preprocessor &pp, const QString &tokenCacheDirectory);
+    bool enterDirectory(const QString &requestDirectory);
+    void leaveDirectory();
+
+    void requestFinished();
+    // milliseconds since the last request finished, 0 while one runs
+    qint64 idleTime();
+    QAtomicInt stopRequested;
+
+protected:
+    void incomingConnection(quintptr socketDescriptor) Q_DECL_OVERRIDE;
+
+private:
+    enum DirectoryState { DirectoryUnknown, DirectoryEntered, DirectoryMissing };
+
+    // the requests for one directory that wait until the current one is left
+    struct DirectoryTurn
+    {
+        QString directory;
+        int number;
+        int requests;
+    };
+
+    void finishRequestInDirectory();
+
+    QThreadPool pool;
+    QMutex mutex;
+    QWaitCondition turnStarted;
+    QString directory;
+    DirectoryState directoryState;
+    int requestsInDirectory;
+    QList<DirectoryTurn> waitingTurns;
+    int lastTurn;
+    int currentTurn;
+    int activeRequests;
+    QElapsedTimer idleTimer;
+    QHash<QByteArray, PreprocessorCache *> caches;
+};
+
+/*
+    Runs moc with the given command line, the program name first. For a
+    request of the moc server, server is set and the Preprocessor uses its
+    caches.
+ */
+static int runMocCommand(const QStringList &commandLine, MocServer *server)
+{
+    MocSettings settings;
+    PreprocessorCache localCache;
     Preprocessor pp;
     Moc moc;
     pp.macros["Q_MOC_RUN"];
@@ -193,11 +884,6 @@ int runMoc(int argc, char **argv)
     pp.macros["__attribute__"] = dummyVariadicFunctionMacro;
     pp.macros["__declspec"] = dummyVariadicFunctionMacro;
 
-    QString filename;
-    QString output;
-    QFile in;
-    FILE *out = 0;
-
     // Note that moc isn't translated.
     // If you use this code as an example for a translated app, make sure to translate the strings.
     QCommandLineParser parser;
@@ -276,39 +962,171 @@ int runMoc(int argc, char **argv)
     ignoreConflictsOption.setDescription(QStringLiteral("Ignore all options that conflict with compilers, like -pthread conflicting with moc's -p option."));
     parser.addOption(ignoreConflictsOption);
 
+    QCommandLineOption jobsOption(QStringLiteral("j"));
+    jobsOption.setDescription(QStringLiteral("Process up to <jobs> input files in parallel (default: number of CPU cores)."));
+    jobsOption.setValueName(QStringLiteral("jobs"));
+    parser.addOption(jobsOption);
+
+    QCommandLineOption cacheDirOption(QStringLiteral("cache-dir"));
+    cacheDirOption.setDescription(QStringLiteral("Reuse the output stored in dir if neither the header nor any file it includes changed."));
+    cacheDirOption.setValueName(QStringLiteral("dir"));
+    parser.addOption(cacheDirOption);
+
+    QCommandLineOption tokenCacheOption(QStringLiteral("token-cache"));
+    tokenCacheOption.setDescription(QStringLiteral("Store tokenized include files in dir and reuse them while they are unchanged."));
+    tokenCacheOption.setValueName(QStringLiteral("dir"));
+    parser.addOption(tokenCacheOption);
+
+    QCommandLineOption includeStatsOption(QStringLiteral("include-stats"));
+    includeStatsOption.setDescription(QStringLiteral("Print how many file system calls the include lookup cache saved."));
+    parser.addOption(includeStatsOption);
+
+    QCommandLineOption cacheStatsOption(QStringLiteral("cache-stats"));
+    cacheStatsOption.setDescription(QStringLiteral("Print hit/miss statistics of the --cache-dir cache and exit."));
+    parser.addOption(cacheStatsOption);
+
+    QCommandLineOption depFileOption(QStringLiteral("output-dep-file"));
+    depFileOption.setDescription(QStringLiteral("Write a make/ninja dependency file listing the input, all included "
+                                                "files and plugin meta data files (default: <output>.d)."));
+    parser.addOption(depFileOption);
+
+    QCommandLineOption depFilePathOption(QStringLiteral("dep-file-path"));
+    depFilePathOption.setDescription(QStringLiteral("Write the dependency file to file instead of <output>.d."));
+    depFilePathOption.setValueName(QStringLiteral("file"));
+    parser.addOption(depFilePathOption);
+
+    QCommandLineOption depFileRuleNameOption(QStringLiteral("dep-file-rule-name"));
+    depFileRuleNameOption.setDescription(QStringLiteral("Use name as the target of the dependency rule instead of the output file."));
+    depFileRuleNameOption.setValueName(QStringLiteral("name"));
+    parser.addOption(depFileRuleNameOption);
+
+    QCommandLineOption writeIfChangedOption(QStringLiteral("write-if-changed"));
+    writeIfChangedOption.setDescription(QStringLiteral("Do not touch output files whose content would not change."));
+    parser.addOption(writeIfChangedOption);
+
+    QCommandLineOption timeReportOption(QStringLiteral("time-report"));
+    timeReportOption.setDescription(QStringLiteral("Print the time, bytes and tokens of each phase and the slowest includes."));
+    parser.addOption(timeReportOption);
+
+    QCommandLineOption timeReportJsonOption(QStringLiteral("time-report-json"));
+    timeReportJsonOption.setDescription(QStringLiteral("Write the time report to file in JSON format."));
+    timeReportJsonOption.setValueName(QStringLiteral("file"));
+    parser.addOption(timeReportJsonOption);
+
+    QCommandLineOption serverOption(QStringLiteral("server"));
+    serverOption.setDescription(QStringLiteral("Keep running and process the requests of moc --client <name>, "
+                                               "keeping include lookups and tokenized include files cached."));
+    serverOption.setValueName(QStringLiteral("name"));
+    parser.addOption(serverOption);
+
+    QCommandLineOption clientOption(QStringLiteral("client"));
+    clientOption.setDescription(QStringLiteral("Let the moc server <name> process this command line, "
+                                               "or process it directly if no server is running."));
+    clientOption.setValueName(QStringLiteral("name"));
+    parser.addOption(clientOption);
+
+    QCommandLineOption idleTimeoutOption(QStringLiteral("idle-timeout"));
+    idleTimeoutOption.setDescription(QStringLiteral("With --server, stop after no request came for <seconds> "
+                                                    "(default: 3600, 0: never)."));
+    idleTimeoutOption.setValueName(QStringLiteral("seconds"));
+    parser.addOption(idleTimeoutOption);
+
+    QCommandLineOption stopServerOption(QStringLiteral("stop-server"));
+    stopServerOption.setDescription(QStringLiteral("Stop the moc server <name> once its running requests are done."));
+    stopServerOption.setValueName(QStringLiteral("name"));
+    parser.addOption(stopServerOption);
+
+    QCommandLineOption pipelineOption(QStringLiteral("pipeline"));
+    pipelineOption.setDescription(QStringLiteral("Preprocess on a second thread while the tokens are prepared for parsing, "
+                                                 "leaving out function bodies of included files. Lowers peak memory use."));
+    parser.addOption(pipelineOption);
+
+    QCommandLineOption nameIndexOption(QStringLiteral("name-index"));
+    nameIndexOption.setDescription(QStringLiteral("Generate qt_moc_indexOfMethod(const Class *, const char *), and the same for "
+                                                  "properties and enumerators, which find a member by name using a perfect hash."));
+    parser.addOption(nameIndexOption);
+
+    QCommandLineOption combineOption(QStringLiteral("combine"));
+    combineOption.setDescription(QStringLiteral("Write the code generated for all input headers to <file> instead of one output "
+                                                "per header, so that the compiler parses the Qt headers once."));
+    combineOption.setValueName(QStringLiteral("file"));
+    parser.addOption(combineOption);
+
+    QCommandLineOption saveStateOption(QStringLiteral("save-state"));
+    saveStateOption.setDescription(QStringLiteral("Preprocess the input file as the prefix header of other inputs "
+                                                  "and write the macros, included files and classes it leaves behind to <file>."));
+    saveStateOption.setValueName(QStringLiteral("file"));
+    parser.addOption(saveStateOption);
+
+    QCommandLineOption loadStateOption(QStringLiteral("load-state"));
+    loadStateOption.setDescription(QStringLiteral("Start each input file from the state saved with --save-state, "
+                                                  "so the files of the prefix header are not preprocessed again."));
+    loadStateOption.setValueName(QStringLiteral("file"));
+    parser.addOption(loadStateOption);
+
+    QCommandLineOption scanOption(QStringLiteral("scan"));
+    scanOption.setDescription(QStringLiteral("Do not generate code, only print those of the header files that contain "
+                                             "Q_OBJECT, Q_GADGET or Q_PLUGIN_METADATA."));
+    parser.addOption(scanOption);
+
     parser.addPositionalArgument(QStringLiteral("[header-file]"),
-            QStringLiteral("Header file to read from, otherwise stdin."));
+            QStringLiteral("Header file to read from, otherwise stdin. Several header files can be "
+                           "processed in one run if each of them gets its own -o option, in the same order."));
     parser.addPositionalArgument(QStringLiteral("[@option-file]"),
             QStringLiteral("Read additional options from option-file."));
 
-    const QStringList arguments = argumentsFromCommandLineAndFile(app.arguments());
+    const QStringList arguments = argumentsFromCommandLineAndFile(commandLine);
     if (arguments.isEmpty())
         return 1;
 
-    parser.process(arguments);
+    processArguments(parser, arguments);
+
+    if (parser.isSet(cacheStatsOption)) {
+        if (!parser.isSet(cacheDirOption)) {
+            error("--cache-stats requires --cache-dir");
+            return 1;
+        }
+        writeStandardOutput(MocCache(parser.value(cacheDirOption)).statistics());
+        return 0;
+    }
 
     const QStringList files = parser.positionalArguments();
-    if (files.count() > 1) {
-        error(qPrintable(QStringLiteral("Too many input files specified: '") + files.join(QStringLiteral("' '")) + QLatin1Char('\'')));
-        parser.showHelp(1);
-    } else if (!files.isEmpty()) {
-        filename = files.first();
+    if (parser.isSet(scanOption))
+        return scanFiles(files);
+
+    const QStringList outputs = parser.values(outputOption);
+    const QString combinedOutput = parser.value(combineOption);
+    if (combinedOutput.size()) {
+        if (outputs.size() || parser.isSet(preprocessOption) || parser.isSet(depFileOption)) {
+            error("--combine cannot be used with -o, -E or --output-dep-file");
+            showHelp(parser, 1);
+        }
+        foreach (const QString &file, files) {
+            const QString suffix = QFileInfo(file).suffix();
+            if (suffix.isEmpty() || suffix.at(0).toLower() != QLatin1Char('h')) {
+                error(qPrintable(QStringLiteral("--combine needs header files, not '") + file + QLatin1Char('\'')));
+                showHelp(parser, 1);
+            }
+        }
+    } else if (files.count() > 1 && outputs.count() != files.count()) {
+        error(qPrintable(QStringLiteral("Too many input files specified: '") + files.join(QStringLiteral("' '")) + QLatin1Char('\'')
+                         + QStringLiteral(" (several input files need one -o option each)")));
+        showHelp(parser, 1);
     }
 
     const bool ignoreConflictingOptions = parser.isSet(ignoreConflictsOption);
-    output = parser.value(outputOption);
     pp.preprocessOnly = parser.isSet(preprocessOption);
     if (parser.isSet(noIncludeOption)) {
         moc.noInclude = true;
-        autoInclude = false;
+        settings.autoInclude = false;
     }
     if (!ignoreConflictingOptions) {
         if (parser.isSet(forceIncludeOption)) {
             moc.noInclude = false;
-            autoInclude = false;
+            settings.autoInclude = false;
             foreach (const QString &include, parser.values(forceIncludeOption)) {
                 moc.includeFiles.append(QFile::encodeName(include));
-                defaultInclude = false;
+                settings.defaultInclude = false;
              }
         }
         foreach (const QString &include, parser.values(prependIncludeOption))
@@ -324,6 +1142,12 @@ int runMoc(int argc, char **argv)
         p.isFrameworkPath = true;
         pp.includes += p;
     }
+    PreprocessorCache *ppCache = &localCache;
+    if (server)
+        ppCache = server->preprocessorCache(pp, parser.value(tokenCacheOption));
+    else
+        localCache.tokenCacheDirectory = parser.value(tokenCacheOption);
+    pp.cache = ppCache;
     foreach (const QString &arg, parser.values(defineOption)) {
         QByteArray name = arg.toLocal8Bit();
         QByteArray value("1");
@@ -334,10 +1158,10 @@ int runMoc(int argc, char **argv)
         }
         if (name.isEmpty()) {
             error("Missing macro name");
-            parser.showHelp(1);
+            showHelp(parser, 1);
         }
         Macro macro;
-        macro.symbols = Preprocessor::tokenize(value, 1, Preprocessor::TokenizeDefine);
+        macro.symbols = pp.tokenize(value, 1, Preprocessor::TokenizeDefine);
         macro.symbols.removeLast(); // remove the EOF symbol
         pp.macros.insert(name, macro);
     }
@@ -345,7 +1169,7 @@ int runMoc(int argc, char **argv)
         QByteArray macro = arg.toLocal8Bit();
         if (macro.isEmpty()) {
             error("Missing macro name");
-            parser.showHelp(1);
+            showHelp(parser, 1);
         }
         pp.macros.remove(macro);
     }
@@ -354,37 +1178,7 @@ int runMoc(int argc, char **argv)
         moc.displayNotes = false;
     if (parser.isSet(noWarningsOption) || noNotesCompatValues.contains(QStringLiteral("w")))
         moc.displayWarnings = moc.displayNotes = false;
-
-    if (autoInclude) {
-        int spos = filename.lastIndexOf(QDir::separator());
-        int ppos = filename.lastIndexOf(QLatin1Char('.'));
-        // spos >= -1 && ppos > spos => ppos >= 0
-        moc.noInclude = (ppos > spos && filename[ppos + 1].toLower() != QLatin1Char('h'));
-    }
-    if (defaultInclude) {
-        if (moc.includePath.isEmpty()) {
-            if (filename.size()) {
-                if (output.size())
-                    moc.includeFiles.append(combinePath(filename, output));
-                else
-                    moc.includeFiles.append(QFile::encodeName(filename));
-            }
-        } else {
-            moc.includeFiles.append(combinePath(filename, filename));
-        }
-    }
-
-    if (filename.isEmpty()) {
-        filename = QStringLiteral("standard input");
-        in.open(stdin, QIODevice::ReadOnly);
-    } else {
-        in.setFileName(filename);
-        if (!in.open(QIODevice::ReadOnly)) {
-            fprintf(stderr, "moc: %s: No such file\n", qPrintable(filename));
-            return 1;
-        }
-        moc.filename = filename.toLocal8Bit();
-    }
+    moc.generateNameIndex = parser.isSet(nameIndexOption);
 
     foreach (const QString &md, parser.values(metadataOption)) {
         int split = md.indexOf(QLatin1Char('='));
@@ -404,49 +1198,460 @@ int runMoc(int argc, char **argv)
         }
     }
 
-    moc.currentFilenames.push(filename.toLocal8Bit());
-    moc.includes = pp.includes;
+    // a state depends on the include paths and the macros defined up front
+    const QList<QCommandLineOption> stateOptions = QList<QCommandLineOption>()
+            << includePathOption << macFrameworkOption << defineOption << undefineOption;
+    if (parser.isSet(saveStateOption)) {
+        if (files.count() != 1 || pp.preprocessOnly) {
+            error("--save-state needs a single input file and cannot be used with -E");
+            showHelp(parser, 1);
+        }
+        return saveState(pp, moc, files.first(), parser.value(saveStateOption),
+                         cacheFingerprint(parser, stateOptions));
+    }
+    if (parser.isSet(loadStateOption)) {
+        if (pp.preprocessOnly) {
+            error("--load-state cannot be used with -E");
+            showHelp(parser, 1);
+        }
+        // without the state the prelude is preprocessed again, same result
+        QByteArray reason;
+        if (!loadMocState(parser.value(loadStateOption), cacheFingerprint(parser, stateOptions), &pp, &moc, &reason)
+            && moc.displayWarnings) {
+            printMessage("moc: Warning: Not using %s: %s\n", qPrintable(parser.value(loadStateOption)),
+                         reason.constData());
+        }
+    }
 
-    // 1. preprocess
-    moc.symbols = pp.preprocessed(moc.filename, &in);
+    QScopedPointer<MocCache> cache;
+    if (parser.isSet(cacheDirOption)) {
+        cache.reset(new MocCache(parser.value(cacheDirOption)));
+        const QList<QCommandLineOption> outputOptions = QList<QCommandLineOption>()
+                << includePathOption << macFrameworkOption << preprocessOption << defineOption
+                << undefineOption << metadataOption << noIncludeOption << pathPrefixOption
+                << forceIncludeOption << prependIncludeOption << ignoreConflictsOption << loadStateOption
+                << nameIndexOption << noNotesOption << noWarningsOption << noNotesWarningsCompatOption;
+        settings.cache = cache.data();
+        settings.cacheFingerprint = cacheFingerprint(parser, outputOptions);
+    }
 
-    if (!pp.preprocessOnly) {
-        // 2. parse
-        moc.parse();
+    if (parser.isSet(depFileOption)) {
+        settings.writeDependencyFile = true;
+        settings.dependencyFilePath = parser.value(depFilePathOption);
+        settings.dependencyRuleName = QFile::encodeName(parser.value(depFileRuleNameOption));
+        if (files.count() > 1 && (parser.isSet(depFilePathOption) || parser.isSet(depFileRuleNameOption))) {
+            error("--dep-file-path and --dep-file-rule-name need a single input file");
+            showHelp(parser, 1);
+        }
+        if (outputs.isEmpty() && (settings.dependencyFilePath.isEmpty() || settings.dependencyRuleName.isEmpty())) {
+            error("--output-dep-file without -o needs --dep-file-path and --dep-file-rule-name");
+            showHelp(parser, 1);
+        }
     }
 
-    // 3. and output meta object code
+    QAtomicInt unchangedOutputs;
+    if (parser.isSet(writeIfChangedOption))
+        settings.unchangedOutputs = &unchangedOutputs;
 
-    if (output.size()) { // output file specified
-#if defined(_MSC_VER) && _MSC_VER >= 1400
-        if (fopen_s(&out, QFile::encodeName(output).constData(), "w"))
+    settings.pipeline = parser.isSet(pipelineOption);
+
+    TimeReport timeReport;
+    if (parser.isSet(timeReportOption) || parser.isSet(timeReportJsonOption))
+        settings.timeReport = &timeReport;
+
+    int jobCount = QThread::idealThreadCount();
+    if (parser.isSet(jobsOption)) {
+        bool ok;
+        jobCount = parser.value(jobsOption).toInt(&ok);
+        if (!ok || jobCount < 1) {
+            error("Invalid number of jobs for option '-j'");
+            showHelp(parser, 1);
+        }
+    }
+
+    int result;
+    if (combinedOutput.size())
+        result = processBatch(pp, moc, settings, files, QStringList(), jobCount, combinedOutput);
+    else if (files.count() <= 1)
+        result = processFile(pp, moc, settings, files.value(0), outputs.value(outputs.count() - 1), 0, settings.timeReport);
+    else
+        result = processBatch(pp, moc, settings, files, outputs, jobCount);
+
+    if (settings.unchangedOutputs && moc.displayNotes && unchangedOutputs.load() > 0)
+        printMessage("moc: Note: %d output file(s) unchanged, not rewritten\n", unchangedOutputs.load());
+
+    if (parser.isSet(includeStatsOption)) {
+        printMessage("moc: include lookup: %d directories listed, %d file system calls made, %d saved\n",
+                ppCache->directoryListings.size(), ppCache->fileSystemCalls, ppCache->fileSystemCallsSaved);
+    }
+
+    if (parser.isSet(timeReportOption))
+        printMessage("%s", timeReport.toText().constData());
+    if (parser.isSet(timeReportJsonOption) && !writeOutput(parser.value(timeReportJsonOption), timeReport.toJson()))
+        result = 1;
+    return result;
+}
+
+PreprocessorCache *MocServer::preprocessorCache(const Preprocessor &pp, const QString &tokenCacheDirectory)
+{
+    QByteArray key = QFile::encodeName(QDir::currentPath()) + '\n' + QFile::encodeName(tokenCacheDirectory);
+    key += pp.preprocessOnly ? "\nE" : "\n";
+    foreach (const Preprocessor::IncludePath &path, pp.includes)
+        key += (path.isFrameworkPath ? "\nF" : "\nI") + path.path;
+
+    PreprocessorCache *cache;
+    {
+        QMutexLocker locker(&mutex);
+        cache = caches.value(key);
+        if (!cache) {
+            cache = new PreprocessorCache;
+            cache->tokenCacheDirectory = tokenCacheDirectory;
+            caches.insert(key, cache);
+            return cache;
+        }
+    }
+    cache->dropChangedDirectories();
+    return cache;
+}
+
+bool MocServer::enterDirectory(const QString &requestDirectory)
+{
+    QMutexLocker locker(&mutex);
+    if (waitingTurns.isEmpty() && (!requestsInDirectory || requestDirectory == directory)) {
+        if (!requestsInDirectory) {
+            directory = requestDirectory;
+            directoryState = DirectoryUnknown;
+        }
+        ++requestsInDirectory;
+    } else {
+        if (waitingTurns.isEmpty() || waitingTurns.last().directory != requestDirectory) {
+            DirectoryTurn turn;
+            turn.directory = requestDirectory;
+            turn.number = ++lastTurn;
+            turn.requests = 0;
+            waitingTurns.append(turn);
+        }
+        ++waitingTurns.last().requests;
+        const int turn = waitingTurns.last().number;
+        // let the pool start another request while this one sleeps
+        pool.releaseThread();
+        while (currentTurn < turn)
+            turnStarted.wait(&mutex);
+        pool.reserveThread();
+    }
+
+    // the first request of a turn changes the directory for all of them
+    if (directoryState == DirectoryUnknown)
+        directoryState = QDir::setCurrent(directory) ? DirectoryEntered : DirectoryMissing;
+    if (directoryState == DirectoryEntered)
+        return true;
+    finishRequestInDirectory();
+    return false;
+}
+
+void MocServer::leaveDirectory()
+{
+    QMutexLocker locker(&mutex);
+    finishRequestInDirectory();
+}
+
+// starts the next turn once the last request in the directory is done;
+// the caller holds the mutex
+void MocServer::finishRequestInDirectory()
+{
+    if (--requestsInDirectory || waitingTurns.isEmpty())
+        return;
+    const DirectoryTurn turn = waitingTurns.takeFirst();
+    directory = turn.directory;
+    directoryState = DirectoryUnknown;
+    requestsInDirectory = turn.requests;
+    currentTurn = turn.number;
+    turnStarted.wakeAll();
+}
+
+void MocServer::requestFinished()
+{
+    QMutexLocker locker(&mutex);
+    --activeRequests;
+    idleTimer.start();
+}
+
+qint64 MocServer::idleTime()
+{
+    QMutexLocker locker(&mutex);
+    return activeRequests ? 0 : idleTimer.elapsed();
+}
+
+// client and server must be the same moc
+static QByteArray serverProtocol()
+{
+    return "moc server 2, output revision " + QByteArray::number(mocOutputRevision) + ", Qt " QT_VERSION_STR;
+}
+
+// a message is a QByteArray in QDataStream format: its size, then the data
+static bool writeMessage(QLocalSocket *socket, const QByteArray &message)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << message;
+    if (socket->write(data) != data.size())
+        return false;
+    while (socket->bytesToWrite()) {
+        if (!socket->waitForBytesWritten(-1))
+            return false;
+    }
+    return true;
+}
+
+// the largest request and response, a command line is far smaller
+enum { MaxRequestSize = 16 * 1024 * 1024, MaxResponseSize = 512 * 1024 * 1024 };
+
+// fails if the message would be larger than maxSize
+static bool readMessage(QLocalSocket *socket, QByteArray *message, int timeout, quint32 maxSize)
+{
+    QByteArray data;
+    quint32 size = 0;
+    while (data.size() < 4 || quint32(data.size()) - 4 < size) {
+        if (!socket->bytesAvailable() && !socket->waitForReadyRead(timeout))
+            return false;
+        data += socket->readAll();
+        if (data.size() >= 4) {
+            QDataStream(data.left(4)) >> size;
+            if (size > maxSize)
+                return false;
+        }
+    }
+    QDataStream(data) >> *message;
+    return true;
+}
+
+/*
+    Whether the process at the other end of a connection runs as the same
+    user as the server. On Windows, the pipe that QLocalServer creates
+    with UserAccessOption admits no one else.
+ */
+static bool clientIsSameUser(quintptr socketDescriptor)
+{
+#if defined(Q_OS_LINUX)
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    return getsockopt(int(socketDescriptor), SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0
+            && credentials.uid == geteuid();
+#elif defined(Q_OS_UNIX)
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(int(socketDescriptor), &uid, &gid) == 0 && uid == geteuid();
 #else
-        out = fopen(QFile::encodeName(output).constData(), "w"); // create output file
-        if (!out)
+    Q_UNUSED(socketDescriptor);
+    return true;
 #endif
-        {
-            fprintf(stderr, "moc: Cannot create %s\n", QFile::encodeName(output).constData());
-            return 1;
+}
+
+struct MocRequest : public QRunnable
+{
+    MocRequest(MocServer *server, quintptr socketDescriptor)
+        : server(server), socketDescriptor(socketDescriptor) {}
+
+    void run() Q_DECL_OVERRIDE;
+    void respond();
+
+    MocServer *server;
+    quintptr socketDescriptor;
+};
+
+void MocRequest::run()
+{
+    respond();
+    server->requestFinished();
+}
+
+/*
+    A request is the protocol, the command line and the working directory
+    of the client, or an empty command line to stop the server. The
+    response is the exit code, or -1 if the client should run moc
+    itself, and what moc wrote to stdout and stderr. Connections from
+    other users and oversized requests are dropped.
+ */
+void MocRequest::respond()
+{
+    QLocalSocket socket;
+    QByteArray request;
+    if (!socket.setSocketDescriptor(socketDescriptor) || !clientIsSameUser(socketDescriptor)
+        || !readMessage(&socket, &request, 30000, MaxRequestSize))
+        return;
+    QDataStream in(request);
+    QByteArray protocol;
+    QStringList commandLine;
+    QString requestDirectory;
+    in >> protocol >> commandLine >> requestDirectory;
+
+    RequestOutput output;
+    int result = -1;
+    if (in.status() != QDataStream::Ok || protocol != serverProtocol()) {
+        // the client runs moc itself
+    } else if (commandLine.isEmpty()) {
+        server->stopRequested.store(1);
+        result = 0;
+    } else if (server->enterDirectory(requestDirectory)) {
+        setCurrentRequestOutput(&output);
+        try {
+            result = runMocCommand(commandLine, server);
+        } catch (const RequestExit &requestExit) {
+            result = requestExit.code;
         }
-    } else { // use stdout
-        out = stdout;
+        setCurrentRequestOutput(0);
+        server->leaveDirectory();
     }
 
-    if (pp.preprocessOnly) {
-        fprintf(out, "%s\n", composePreprocessorOutput(moc.symbols).constData());
-    } else {
-        if (moc.classList.isEmpty())
-            moc.note("No relevant classes found. No output generated.");
-        else
-            moc.generate(out);
+    QByteArray response;
+    QDataStream out(&response, QIODevice::WriteOnly);
+    out << qint32(result) << output.out.data() << output.err.data();
+    writeMessage(&socket, response);
+}
+
+void MocServer::incomingConnection(quintptr socketDescriptor)
+{
+    {
+        QMutexLocker locker(&mutex);
+        ++activeRequests;
     }
+    pool.start(new MocRequest(this, socketDescriptor));
+}
 
-    if (output.size())
-        fclose(out);
+// idleTimeout in seconds, 0 to run until stopped
+static int runServer(const QString &name, int idleTimeout)
+{
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(1000)) {
+        printMessage("moc: A server is already listening on %s\n", qPrintable(name));
+        return 1;
+    }
+    probe.abort();
 
+    // remove the socket a server that did not shut down may have left behind
+    QLocalServer::removeServer(name);
+    MocServer server;
+    server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!server.listen(name)) {
+        printMessage("moc: Cannot listen on %s: %s\n", qPrintable(name), qPrintable(server.errorString()));
+        return 1;
+    }
+    // wake up every second to check for a stop request and the idle timeout
+    for (;;) {
+        bool timedOut = false;
+        if (!server.waitForNewConnection(1000, &timedOut) && !timedOut)
+            break;
+        if (server.stopRequested.load()
+            || (idleTimeout > 0 && server.idleTime() >= qint64(idleTimeout) * 1000))
+            break;
+    }
+    // removes the socket; requests already accepted are finished first
+    server.close();
     return 0;
 }
 
+// -1 if no server answered, the caller then runs moc itself
+static int runClient(const QString &name, const QStringList &commandLine)
+{
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    if (!socket.waitForConnected(1000))
+        return -1;
+
+    QByteArray request;
+    QDataStream out(&request, QIODevice::WriteOnly);
+    out << serverProtocol() << commandLine << QDir::currentPath();
+    QByteArray response;
+    if (!writeMessage(&socket, request) || !readMessage(&socket, &response, -1, MaxResponseSize))
+        return -1;
+
+    QDataStream in(response);
+    qint32 result;
+    QByteArray standardOutput;
+    QByteArray standardError;
+    in >> result >> standardOutput >> standardError;
+    if (in.status() != QDataStream::Ok || result < 0)
+        return -1;
+    fwrite(standardOutput.constData(), 1, standardOutput.size(), stdout);
+    fwrite(standardError.constData(), 1, standardError.size(), stderr);
+    return result;
+}
+
+static int stopServer(const QString &name)
+{
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    if (!socket.waitForConnected(1000)) {
+        printMessage("moc: No server is listening on %s\n", qPrintable(name));
+        return 1;
+    }
+
+    QByteArray request;
+    QDataStream out(&request, QIODevice::WriteOnly);
+    out << serverProtocol() << QStringList() << QString();
+    QByteArray response;
+    qint32 result = -1;
+    if (writeMessage(&socket, request) && readMessage(&socket, &response, 30000, MaxResponseSize))
+        QDataStream(response) >> result;
+    if (result != 0) {
+        printMessage("moc: The server on %s did not stop, it may be a different moc\n", qPrintable(name));
+        return 1;
+    }
+    return 0;
+}
+
+// removes --name <value> or --name=<value> from arguments and returns the value
+static QString takeOption(QStringList *arguments, const QString &name)
+{
+    const QString option = QStringLiteral("--") + name;
+    for (int i = 1; i < arguments->size(); ++i) {
+        const QString &argument = arguments->at(i);
+        if (argument == option && i + 1 < arguments->size()) {
+            arguments->removeAt(i);
+            return arguments->takeAt(i);
+        }
+        if (argument.startsWith(option + QLatin1Char('=')))
+            return arguments->takeAt(i).mid(option.size() + 1);
+    }
+    return QString();
+}
+
+int runMoc(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationVersion(QString::fromLatin1(QT_VERSION_STR));
+
+    // --server and --client decide where the command line runs, they are
+    // handled before it is parsed
+    QStringList commandLine = app.arguments();
+    const QString stopServerName = takeOption(&commandLine, QStringLiteral("stop-server"));
+    if (!stopServerName.isEmpty())
+        return stopServer(stopServerName);
+    const QString serverName = takeOption(&commandLine, QStringLiteral("server"));
+    if (!serverName.isEmpty()) {
+        const QString idleTimeoutValue = takeOption(&commandLine, QStringLiteral("idle-timeout"));
+        bool ok = true;
+        const int idleTimeout = idleTimeoutValue.isEmpty() ? 3600 : idleTimeoutValue.toInt(&ok);
+        if (!ok || idleTimeout < 0) {
+            error("Invalid value for option '--idle-timeout'");
+            return 1;
+        }
+        if (commandLine.size() > 1) {
+            error("--server takes no other options than --idle-timeout, and no files");
+            return 1;
+        }
+        return runServer(serverName, idleTimeout);
+    }
+    const QString clientName = takeOption(&commandLine, QStringLiteral("client"));
+    if (!clientName.isEmpty()) {
+        const int result = runClient(clientName, commandLine);
+        if (result >= 0)
+            return result;
+    }
+    return runMocCommand(commandLine, 0);
+}
+
 QT_END_NAMESPACE
 
 int main(int _argc, char **_argv)
@@ -40,6 +40,7 @@
 #include <QtCore/qfile.h>
 #include <QtCore/qfileinfo.h>
 #include <QtCore/qdir.h>
+#include <QtCore/qmutex.h>
 
 // for normalizeTypeInternal
 #include <QtCore/5.6.3/QtCore/private/qmetaobject_moc_p.h>
@@ -74,6 +75,49 @@ static QByteArray normalizeType(const QByteArray &ba, bool fixScope = false)
     return result;
 }
 
+/*
+    Normalized type names by their spelling as moc assembled it from the
+    tokens. Signals, slots and properties use the same few types over and
+    over, and the result only depends on the spelling, so one cache serves
+    all input files of the process, also across the requests of a moc
+    server.
+*/
+struct NormalizedTypeCache
+{
+    enum { MaxSize = 1 << 16 };
+
+    QMutex mutex;
+    QHash<QByteArray, QByteArray> types;
+};
+
+static NormalizedTypeCache &normalizedTypeCache()
+{
+    static NormalizedTypeCache cache;
+    return cache;
+}
+
+QByteArray Moc::normalizedType(const QByteArray &type)
+{
+    NormalizedTypeCache &cache = normalizedTypeCache();
+    {
+        QMutexLocker locker(&cache.mutex);
+        QHash<QByteArray, QByteArray>::const_iterator it = cache.types.constFind(type);
+        if (it != cache.types.constEnd()) {
+            if (timeReport)
+                ++timeReport->normalizedTypeHits;
+            return *it;
+        }
+    }
+    const QByteArray result = normalizeType(type);
+    if (timeReport)
+        ++timeReport->normalizedTypeMisses;
+    QMutexLocker locker(&cache.mutex);
+    if (cache.types.size() >= NormalizedTypeCache::MaxSize)
+        cache.types.clear();
+    cache.types.insert(type, result);
+    return result;
+}
+
 bool Moc::parseClassHead(ClassDef *def)
 {
     // figure out whether this is a class declaration, or only a
@@ -100,14 +144,14 @@ bool Moc::parseClassHead(ClassDef *def)
             return false;
         name = lexem();
     } else  if (test(IDENTIFIER)) {
-        const QByteArray lex = lexem();
+        const LexemView lex = lexemView();
         if (lex != "final" && lex != "sealed" && lex != "Q_DECL_FINAL")
-            name = lex;
+            name = lex.toByteArray();
     }
 
     def->qualified += name;
     while (test(SCOPE)) {
-        def->qualified += lexem();
+        def->qualified += lexemView();
         if (test(IDENTIFIER)) {
             name = lexem();
             def->qualified += name;
@@ -116,7 +160,7 @@ bool Moc::parseClassHead(ClassDef *def)
     def->classname = name;
 
     if (test(IDENTIFIER)) {
-        const QByteArray lex = lexem();
+        const LexemView lex = lexemView();
         if (lex != "final" && lex != "sealed" && lex != "Q_DECL_FINAL")
             return false;
     }
@@ -171,7 +215,7 @@ Type Moc::parseType()
                 // fall through
             case CONST:
             case VOLATILE:
-                type.name += lexem();
+                type.name += lexemView();
                 type.name += ' ';
                 if (lookup(0) == VOLATILE)
                     type.isVolatile = true;
@@ -183,7 +227,7 @@ Type Moc::parseType()
             case Q_SLOTS_TOKEN:
             case Q_SIGNAL_TOKEN:
             case Q_SLOT_TOKEN:
-                type.name += lexem();
+                type.name += lexemView();
                 return type;
             case NOTOKEN:
                 return type;
@@ -206,7 +250,7 @@ Type Moc::parseType()
         case SHORT:
         case INT:
         case LONG:
-            type.name += lexem();
+            type.name += lexemView();
             // preserve '[unsigned] long long', 'short int', 'long int', 'long double'
             if (test(LONG) || test(INT) || test(DOUBLE)) {
                 type.name += ' ';
@@ -218,7 +262,7 @@ Type Moc::parseType()
         case DOUBLE:
         case VOID:
         case BOOL:
-            type.name += lexem();
+            type.name += lexemView();
             isVoid |= (lookup(0) == VOID);
             break;
         case NOTOKEN:
@@ -235,7 +279,7 @@ Type Moc::parseType()
             type.name += lexemUntil(RANGLE);
         }
         if (test(SCOPE)) {
-            type.name += lexem();
+            type.name += lexemView();
             type.isScoped = true;
         } else {
             break;
@@ -244,7 +288,7 @@ Type Moc::parseType()
     while (test(CONST) || test(VOLATILE) || test(SIGNED) || test(UNSIGNED)
            || test(STAR) || test(AND) || test(ANDAND)) {
         type.name += ' ';
-        type.name += lexem();
+        type.name += lexemView();
         if (lookup(0) == AND)
             type.referenceType = Type::Reference;
         else if (lookup(0) == ANDAND)
@@ -310,10 +354,10 @@ void Moc::parseFunctionArguments(FunctionDef *def)
         }
         if (test(CONST) || test(VOLATILE)) {
             arg.rightType += ' ';
-            arg.rightType += lexem();
+            arg.rightType += lexemView();
         }
-        arg.normalizedType = normalizeType(QByteArray(arg.type.name + ' ' + arg.rightType));
-        arg.typeNameForCast = normalizeType(QByteArray(noRef(arg.type.name) + "(*)" + arg.rightType));
+        arg.normalizedType = normalizedType(QByteArray(arg.type.name + ' ' + arg.rightType));
+        arg.typeNameForCast = normalizedType(QByteArray(noRef(arg.type.name) + "(*)" + arg.rightType));
         if (test(EQ))
             arg.isDefault = true;
         def->arguments += arg;
@@ -330,7 +374,7 @@ void Moc::parseFunctionArguments(FunctionDef *def)
 
 bool Moc::testFunctionAttribute(FunctionDef *def)
 {
-    if (index < symbols.size() && testFunctionAttribute(symbols.at(index).token, def)) {
+    if (index < symbols.size() && testFunctionAttribute(symbols.tokenAt(index), def)) {
         ++index;
         return true;
     }
@@ -428,7 +472,7 @@ bool Moc::parseFunction(FunctionDef *def, bool inMacro)
         def->type.rawName = rawName;
     }
 
-    def->normalizedType = normalizeType(def->type.name);
+    def->normalizedType = normalizedType(def->type.name);
 
     if (!test(RPAREN)) {
         parseFunctionArguments(def);
@@ -526,7 +570,7 @@ bool Moc::parseMaybeFunction(const ClassDef *cdef, FunctionDef *def)
         def->type.rawName = rawName;
     }
 
-    def->normalizedType = normalizeType(def->type.name);
+    def->normalizedType = normalizedType(def->type.name);
 
     if (!test(RPAREN)) {
         parseFunctionArguments(def);
@@ -546,8 +590,63 @@ bool Moc::parseMaybeFunction(const ClassDef *cdef, FunctionDef *def)
 }
 
 
+void IncludedBodyFilter::filter(const Symbols &symbols, Symbols *kept)
+{
+    kept->reserve(kept->size() + symbols.size());
+    foreach (const Symbol &sym, symbols) {
+        const Token t = sym.token;
+        if (t == MOC_INCLUDE_BEGIN) {
+            ++includeDepth;
+        } else if (t == MOC_INCLUDE_END) {
+            --includeDepth;
+        } else if (bodyDepth) {
+            if (t == LBRACE)
+                ++bodyDepth;
+            else if (t == RBRACE)
+                --bodyDepth;
+            if (bodyDepth) {
+                ++dropped;
+                continue;
+            }
+        } else if (t == LBRACE && includeDepth && afterParameters && !declaresType) {
+            bodyDepth = 1;
+        }
+
+        switch (t) {
+        case RPAREN:
+            afterParameters = true;
+            break;
+        case CONST:
+        case VOLATILE:
+        case IDENTIFIER: // override, final, noexcept, Q_DECL_OVERRIDE...
+            break;
+        default:
+            afterParameters = false;
+        }
+        switch (t) {
+        case CLASS:
+        case STRUCT:
+        case UNION:
+        case ENUM:
+        case NAMESPACE:
+            declaresType = true;
+            break;
+        case SEMIC:
+        case LBRACE:
+        case RBRACE:
+            declaresType = false;
+            break;
+        default:
+            break;
+        }
+        *kept += sym;
+    }
+}
+
 void Moc::parse()
 {
+    indexBrackets();
+
     QList<NamespaceDef> namespaceList;
     bool templateClass = false;
     while (hasNext()) {
@@ -843,7 +942,7 @@ static void findRequiredContainers(ClassDef *cdef, QSet<QByteArray> *requiredQtC
     }
 }
 
-void Moc::generate(FILE *out)
+void Moc::generate(OutputBuffer *out)
 {
     QByteArray fn = filename;
     int i = filename.length()-1;
@@ -851,10 +950,10 @@ void Moc::generate(FILE *out)
         --i;                                // skip path
     if (i >= 0)
         fn = filename.mid(i);
-    fprintf(out, "/****************************************************************************\n"
+    out->print("/****************************************************************************\n"
             "** Meta object code from reading C++ file '%s'\n**\n" , fn.constData());
-    fprintf(out, "** Created by: The Qt Meta Object Compiler version %d (Qt %s)\n**\n" , mocOutputRevision, QT_VERSION_STR);
-    fprintf(out, "** WARNING! All changes made in this file will be lost!\n"
+    out->print("** Created by: The Qt Meta Object Compiler version %d (Qt %s)\n**\n" , mocOutputRevision, QT_VERSION_STR);
+    out->write("** WARNING! All changes made in this file will be lost!\n"
             "*****************************************************************************/\n\n");
 
 
@@ -868,16 +967,16 @@ void Moc::generate(FILE *out)
                     inc.prepend(includePath);
                 inc = '\"' + inc + '\"';
             }
-            fprintf(out, "#include %s\n", inc.constData());
+            out->print("#include %s\n", inc.constData());
         }
     }
     if (classList.size() && classList.first().classname == "Qt")
-        fprintf(out, "#include <QtCore/qobject.h>\n");
+        out->write("#include <QtCore/qobject.h>\n");
 
-    fprintf(out, "#include <QtCore/qbytearray.h>\n"); // For QByteArrayData
-    fprintf(out, "#include <QtCore/qmetatype.h>\n");  // For QMetaType::Type
+    out->write("#include <QtCore/qbytearray.h>\n"); // For QByteArrayData
+    out->write("#include <QtCore/qmetatype.h>\n");  // For QMetaType::Type
     if (mustIncludeQPluginH)
-        fprintf(out, "#include <QtCore/qplugin.h>\n");
+        out->write("#include <QtCore/qplugin.h>\n");
 
     QSet<QByteArray> requiredQtContainers;
     for (i = 0; i < classList.size(); ++i) {
@@ -890,27 +989,28 @@ void Moc::generate(FILE *out)
     std::sort(requiredContainerList.begin(), requiredContainerList.end());
 
     foreach (const QByteArray &qtContainer, requiredContainerList) {
-        fprintf(out, "#include <QtCore/%s>\n", qtContainer.constData());
+        out->print("#include <QtCore/%s>\n", qtContainer.constData());
     }
 
 
-    fprintf(out, "#if !defined(Q_MOC_OUTPUT_REVISION)\n"
+    out->print("#if !defined(Q_MOC_OUTPUT_REVISION)\n"
             "#error \"The header file '%s' doesn't include <QObject>.\"\n", fn.constData());
-    fprintf(out, "#elif Q_MOC_OUTPUT_REVISION != %d\n", mocOutputRevision);
-    fprintf(out, "#error \"This file was generated using the moc from %s."
+    out->print("#elif Q_MOC_OUTPUT_REVISION != %d\n", mocOutputRevision);
+    out->print("#error \"This file was generated using the moc from %s."
             " It\"\n#error \"cannot be used with the include files from"
             " this version of Qt.\"\n#error \"(The moc has changed too"
             " much.)\"\n", QT_VERSION_STR);
-    fprintf(out, "#endif\n\n");
+    out->write("#endif\n\n");
 
-    fprintf(out, "QT_BEGIN_MOC_NAMESPACE\n");
+    out->write("QT_BEGIN_MOC_NAMESPACE\n");
 
     for (i = 0; i < classList.size(); ++i) {
         Generator generator(&classList[i], metaTypes, knownQObjectClasses, knownGadgets, out);
+        generator.generateNameIndex = generateNameIndex;
         generator.generateCode();
     }
 
-    fprintf(out, "QT_END_MOC_NAMESPACE\n");
+    out->write("QT_END_MOC_NAMESPACE\n");
 }
 
 void Moc::parseSlots(ClassDef *def, FunctionDef::Access access)
@@ -1038,7 +1138,7 @@ void Moc::createPropertyDef(PropertyDef &propDef)
       QValueList<QVariant>, the other template class supported by
       QVariant.
     */
-    type = normalizeType(type);
+    type = normalizedType(type);
     if (type == "QMap")
         type = "QMap<QString,QVariant>";
     else if (type == "QValueList")
@@ -1053,11 +1153,11 @@ void Moc::createPropertyDef(PropertyDef &propDef)
     next();
     propDef.name = lexem();
     while (test(IDENTIFIER)) {
-        QByteArray l = lexem();
-        if (l[0] == 'C' && l == "CONSTANT") {
+        const LexemView l = lexemView();
+        if (l.first() == 'C' && l == "CONSTANT") {
             propDef.constant = true;
             continue;
-        } else if(l[0] == 'F' && l == "FINAL") {
+        } else if(l.first() == 'F' && l == "FINAL") {
             propDef.final = true;
             continue;
         }
@@ -1078,7 +1178,7 @@ void Moc::createPropertyDef(PropertyDef &propDef)
             else if (v != "true" && v != "false")
                 v2 = "()";
         }
-        switch (l[0]) {
+        switch (l.first()) {
         case 'M':
             if (l == "MEMBER")
                 propDef.member = v;
@@ -1169,7 +1269,7 @@ void Moc::parsePluginData(ClassDef *def)
     next(LPAREN);
     QByteArray metaData;
     while (test(IDENTIFIER)) {
-        QByteArray l = lexem();
+        const LexemView l = lexemView();
         if (l == "IID") {
             next(STRING_LITERAL);
             def->pluginData.iid = unquotedLexem();
@@ -1192,7 +1292,7 @@ void Moc::parsePluginData(ClassDef *def)
             if (!fi.exists()) {
                 QByteArray msg;
                 msg += "Plugin Metadata file ";
-                msg += lexem();
+                msg += lexemView();
                 msg += " does not exist. Declaration will be ignored";
                 error(msg.constData());
                 return;
@@ -1200,6 +1300,7 @@ void Moc::parsePluginData(ClassDef *def)
             QFile file(fi.canonicalFilePath());
             file.open(QFile::ReadOnly);
             metaData = file.readAll();
+            pluginMetaDataFiles.append(QFile::encodeName(fi.canonicalFilePath()));
         }
     }
 
@@ -1208,7 +1309,7 @@ void Moc::parsePluginData(ClassDef *def)
         if (!def->pluginData.metaData.isObject()) {
             QByteArray msg;
             msg += "Plugin Metadata file ";
-            msg += lexem();
+            msg += lexemView();
             msg += " does not contain a valid JSON object. Declaration will be ignored";
             warning(msg.constData());
             def->pluginData.iid = QByteArray();
@@ -1227,9 +1328,9 @@ void Moc::parsePrivateProperty(ClassDef *def)
     next(IDENTIFIER);
     propDef.inPrivateClass = lexem();
     while (test(SCOPE)) {
-        propDef.inPrivateClass += lexem();
+        propDef.inPrivateClass += lexemView();
         next(IDENTIFIER);
-        propDef.inPrivateClass += lexem();
+        propDef.inPrivateClass += lexemView();
     }
     // also allow void functions
     if (test(LPAREN)) {
@@ -1257,7 +1358,7 @@ void Moc::parseEnumOrFlag(ClassDef *def, bool isFlag)
         identifier = lexem();
         while (test(SCOPE) && test(IDENTIFIER)) {
             identifier += "::";
-            identifier += lexem();
+            identifier += lexemView();
         }
         def->enumDeclarations[identifier] = isFlag;
     }
@@ -1272,7 +1373,7 @@ void Moc::parseFlag(ClassDef *def)
         flagName = lexem();
         while (test(SCOPE) && test(IDENTIFIER)) {
             flagName += "::";
-            flagName += lexem();
+            flagName += lexemView();
         }
     }
     next(COMMA);
@@ -1280,7 +1381,7 @@ void Moc::parseFlag(ClassDef *def)
         enumName = lexem();
         while (test(SCOPE) && test(IDENTIFIER)) {
             enumName += "::";
-            enumName += lexem();
+            enumName += lexemView();
         }
     }
 
@@ -1316,17 +1417,17 @@ void Moc::parseInterfaces(ClassDef *def)
         QList<ClassDef::Interface> iface;
         iface += ClassDef::Interface(lexem());
         while (test(SCOPE)) {
-            iface.last().className += lexem();
+            iface.last().className += lexemView();
             next(IDENTIFIER);
-            iface.last().className += lexem();
+            iface.last().className += lexemView();
         }
         while (test(COLON)) {
             next(IDENTIFIER);
             iface += ClassDef::Interface(lexem());
             while (test(SCOPE)) {
-                iface.last().className += lexem();
+                iface.last().className += lexemView();
                 next(IDENTIFIER);
-                iface.last().className += lexem();
+                iface.last().className += lexemView();
             }
         }
         // resolve from classnames to interface ids
@@ -1347,11 +1448,11 @@ void Moc::parseDeclareInterface()
     next(LPAREN);
     QByteArray interface;
     next(IDENTIFIER);
-    interface += lexem();
+    interface += lexemView();
     while (test(SCOPE)) {
-        interface += lexem();
+        interface += lexemView();
         next(IDENTIFIER);
-        interface += lexem();
+        interface += lexemView();
     }
     next(COMMA);
     QByteArray iid;
@@ -1405,10 +1506,10 @@ QByteArray Moc::lexemUntil(Token target)
     until(target);
     QByteArray s;
     while (from <= index) {
-        QByteArray n = symbols.at(from++-1).lexem();
-        if (s.size() && n.size()) {
+        const LexemView n = symbols.lexemViewAt(from++-1);
+        if (s.size() && n.size) {
             char prev = s.at(s.size()-1);
-            char next = n.at(0);
+            char next = n.first();
             if ((is_ident_char(prev) && is_ident_char(next))
                 || (prev == '<' && next == ':')
                 || (prev == '>' && next == '>'))
@@ -1419,13 +1520,73 @@ QByteArray Moc::lexemUntil(Token target)
     return s;
 }
 
+/*
+    Matches brackets once for the whole input, so that until() does not
+    count its way through class bodies, function bodies and argument lists
+    again and again. A pair is only recorded if skipping it is equivalent to
+    counting through it: all brackets in between are properly nested, and
+    no ';' appears in parentheses outside of braces. Square brackets are
+    matched for nesting, but never skipped, as until() counts the angle
+    brackets in them.
+*/
+void Moc::indexBrackets()
+{
+    const int count = symbols.size();
+    closingBrackets.fill(-1, count);
+    bracketsWithAssignment.fill(false, count);
+    QBitArray unsafe(count);
+    QVector<int> open;
+    for (int i = 0; i < count; ++i) {
+        const Token t = symbols.tokenAt(i);
+        switch (t) {
+        case LBRACE:
+        case LPAREN:
+        case LBRACK:
+            open.append(i);
+            break;
+        case RBRACE:
+        case RPAREN:
+        case RBRACK: {
+            const Token opening = (t == RBRACE ? LBRACE : t == RPAREN ? LPAREN : LBRACK);
+            if (!open.isEmpty() && symbols.tokenAt(open.last()) == opening) {
+                const int begin = open.takeLast();
+                if (opening != LBRACK && !unsafe.testBit(begin))
+                    closingBrackets[begin] = i;
+                if (!open.isEmpty() && bracketsWithAssignment.testBit(begin))
+                    bracketsWithAssignment.setBit(open.last());
+                break;
+            }
+            // mismatched: every enclosing pair is counted through
+            for (int j = 0; j < open.size(); ++j)
+                unsafe.setBit(open.at(j));
+            int j = open.size();
+            while (j > 0 && symbols.tokenAt(open.at(j - 1)) != opening)
+                --j;
+            if (j > 0)
+                open.resize(j - 1);
+            break;
+        }
+        case SEMIC:
+            for (int j = open.size() - 1; j >= 0 && symbols.tokenAt(open.at(j)) != LBRACE; --j)
+                unsafe.setBit(open.at(j));
+            break;
+        case EQ:
+            if (!open.isEmpty())
+                bracketsWithAssignment.setBit(open.last());
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 bool Moc::until(Token target) {
     int braceCount = 0;
     int brackCount = 0;
     int parenCount = 0;
     int angleCount = 0;
     if (index) {
-        switch(symbols.at(index-1).token) {
+        switch(symbols.tokenAt(index-1)) {
         case LBRACE: ++braceCount; break;
         case LBRACK: ++brackCount; break;
         case LPAREN: ++parenCount; break;
@@ -1440,7 +1601,13 @@ bool Moc::until(Token target) {
     int possible = -1;
 
     while (index < symbols.size()) {
-        Token t = symbols.at(index++).token;
+        // nothing between balanced braces or parentheses changes the outcome,
+        // except an '=' ending the search for a comma
+        if (index && closingBrackets.at(index - 1) >= 0
+            && (possible == -1 || !bracketsWithAssignment.testBit(index - 1)))
+            index = closingBrackets.at(index - 1);
+
+        Token t = symbols.tokenAt(index++);
         switch (t) {
         case LBRACE: ++braceCount; break;
         case RBRACE: --braceCount; break;
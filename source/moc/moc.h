@@ -35,9 +35,12 @@
 #define MOC_H
 
 #include "parser.h"
+#include "outputbuffer.h"
+#include "timereport.h"
 #include <qstringlist.h>
 #include <qmap.h>
 #include <qpair.h>
+#include <qbitarray.h>
 #include <qjsondocument.h>
 #include <qjsonarray.h>
 #include <qjsonobject.h>
@@ -190,17 +193,19 @@ struct NamespaceDef {
     int end;
 };
 
-class Moc : public Parser
+class Moc : public BasicParser<TokenBuffer>
 {
 public:
     Moc()
-        : noInclude(false), mustIncludeQPluginH(false)
+        : noInclude(false), mustIncludeQPluginH(false), generateNameIndex(false), timeReport(0)
         {}
 
     QByteArray filename;
 
     bool noInclude;
     bool mustIncludeQPluginH;
+    // emit hashed name lookup functions for each class
+    bool generateNameIndex;
     QByteArray includePath;
     QList<QByteArray> includeFiles;
     QList<ClassDef> classList;
@@ -210,9 +215,13 @@ public:
     QHash<QByteArray, QByteArray> knownQObjectClasses;
     QHash<QByteArray, QByteArray> knownGadgets;
     QMap<QString, QJsonArray> metaArgs;
+    // files read for Q_PLUGIN_METADATA(... FILE ...), canonical paths
+    QList<QByteArray> pluginMetaDataFiles;
+    // if set, normalized type cache lookups are counted here
+    TimeReport *timeReport;
 
     void parse();
-    void generate(FILE *out);
+    void generate(OutputBuffer *out);
 
     bool parseClassHead(ClassDef *def);
     inline bool inClass(const ClassDef *def) const {
@@ -224,6 +233,7 @@ public:
     }
 
     Type parseType();
+    QByteArray normalizedType(const QByteArray &type);
 
     bool parseEnum(EnumDef *def);
 
@@ -249,6 +259,13 @@ public:
     QByteArray lexemUntil(Token);
     bool until(Token);
 
+    // for each '{' and '(' the index of its matching '}' or ')', if until()
+    // can jump there; built by indexBrackets() before parsing
+    QVector<int> closingBrackets;
+    // '{' and '(' enclosing an '='
+    QBitArray bracketsWithAssignment;
+    void indexBrackets();
+
     // test for Q_INVOCABLE, Q_SCRIPTABLE, etc. and set the flags
     // in FunctionDef accordingly
     bool testFunctionAttribute(FunctionDef *def);
@@ -259,6 +276,36 @@ public:
     void checkProperties(ClassDef* cdef);
 };
 
+/*
+    Leaves out the contents of function bodies in included files, for a
+    token stream that is passed to Moc::parse() in chunks. In included
+    files moc only looks for namespaces, classes with Q_OBJECT or
+    Q_GADGET and Q_DECLARE_* declarations, and none of these can appear in
+    a function body: a local class cannot have the static members Q_OBJECT
+    and Q_GADGET declare. The braces stay, so brackets still match.
+
+    A '{' starts a function body if it follows a ')', possibly with
+    const, override or the like in between, and the statement does not
+    declare a class, enum or namespace.
+*/
+class IncludedBodyFilter
+{
+public:
+    IncludedBodyFilter()
+        : includeDepth(0), bodyDepth(0), afterParameters(false), declaresType(false), dropped(0) {}
+
+    void filter(const Symbols &symbols, Symbols *kept);
+
+private:
+    int includeDepth;
+    int bodyDepth;
+    bool afterParameters;
+    bool declaresType;
+
+public:
+    qint64 dropped;
+};
+
 inline QByteArray noRef(const QByteArray &type)
 {
     if (type.endsWith('&')) {
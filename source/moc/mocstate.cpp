@@ -0,0 +1,173 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "mocstate.h"
+#include "preprocessor.h"
+#include "moc.h"
+
+#include <qdatastream.h>
+#include <qdatetime.h>
+#include <qfile.h>
+#include <qfileinfo.h>
+#include <qsavefile.h>
+
+QT_BEGIN_NAMESPACE
+
+// bump when the state or what moc does with it changes
+static const char stateFormat[] = "moc-state 1 " QT_VERSION_STR;
+
+static void writeSymbols(QDataStream &stream, const Symbols &symbols)
+{
+    stream << qint32(symbols.size());
+    foreach (const Symbol &sym, symbols)
+        stream << qint32(sym.lineNum) << qint32(sym.token) << sym.lexem();
+}
+
+static bool readSymbols(QDataStream &stream, Symbols *symbols)
+{
+    qint32 count;
+    stream >> count;
+    if (stream.status() != QDataStream::Ok || count < 0)
+        return false;
+    // a damaged count must not make us allocate more than the file holds;
+    // each symbol takes at least two qint32 and an empty lexem
+    symbols->reserve(int(qMin<qint64>(count, stream.device()->bytesAvailable() / 12)));
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 lineNum, token;
+        QByteArray lexem;
+        stream >> lineNum >> token >> lexem;
+        *symbols += Symbol(lineNum, Token(token), lexem);
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool saveMocState(const QString &path, const QByteArray &fingerprint, const Preprocessor &pp, const Moc &moc)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << QByteArray(stateFormat) << fingerprint;
+
+    stream << qint32(pp.preprocessedIncludes.size());
+    foreach (const QByteArray &include, pp.preprocessedIncludes) {
+        const QFileInfo fi(QString::fromLocal8Bit(include.constData()));
+        stream << include << fi.size() << fi.lastModified().toMSecsSinceEpoch();
+    }
+
+    qint32 defined = 0;
+    for (int id = 0; id < pp.macros.idCount(); ++id)
+        defined += pp.macros.isDefined(id);
+    stream << defined;
+    for (int id = 0; id < pp.macros.idCount(); ++id) {
+        if (!pp.macros.isDefined(id))
+            continue;
+        const Macro &macro = pp.macros.macro(id);
+        stream << pp.macros.name(id) << macro.isFunction << macro.isVariadic;
+        writeSymbols(stream, macro.arguments);
+        writeSymbols(stream, macro.symbols);
+    }
+
+    stream << moc.knownQObjectClasses << moc.knownGadgets << moc.metaTypes << moc.interface2IdMap;
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+bool loadMocState(const QString &path, const QByteArray &fingerprint, Preprocessor *pp, Moc *moc,
+                  QByteArray *errorString)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorString = "cannot be opened";
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    QByteArray format, storedFingerprint;
+    stream >> format >> storedFingerprint;
+    if (stream.status() != QDataStream::Ok || format != stateFormat) {
+        *errorString = "not saved by this moc";
+        return false;
+    }
+    if (storedFingerprint != fingerprint) {
+        *errorString = "saved with different include paths or macro options";
+        return false;
+    }
+
+    qint32 count;
+    stream >> count;
+    QSet<QByteArray> includes;
+    for (qint32 i = 0; stream.status() == QDataStream::Ok && i < count; ++i) {
+        QByteArray include;
+        qint64 size, lastModified;
+        stream >> include >> size >> lastModified;
+        const QFileInfo fi(QString::fromLocal8Bit(include.constData()));
+        if (stream.status() == QDataStream::Ok
+            && (fi.size() != size || fi.lastModified().toMSecsSinceEpoch() != lastModified)) {
+            *errorString = include + " changed";
+            return false;
+        }
+        includes.insert(include);
+    }
+
+    // the state was saved with the same -D and -U options, so its macros
+    // replace those already defined
+    MacroTable macros;
+    stream >> count;
+    for (qint32 i = 0; stream.status() == QDataStream::Ok && i < count; ++i) {
+        QByteArray name;
+        Macro macro;
+        stream >> name >> macro.isFunction >> macro.isVariadic;
+        if (!readSymbols(stream, &macro.arguments) || !readSymbols(stream, &macro.symbols))
+            break;
+        macros.insert(name, macro);
+    }
+
+    QHash<QByteArray, QByteArray> knownQObjectClasses, knownGadgets;
+    QList<QByteArray> metaTypes;
+    QMap<QByteArray, QByteArray> interface2IdMap;
+    stream >> knownQObjectClasses >> knownGadgets >> metaTypes >> interface2IdMap;
+    if (stream.status() != QDataStream::Ok) {
+        *errorString = "is damaged";
+        return false;
+    }
+
+    // loaded before anything is preprocessed or parsed
+    pp->preprocessedIncludes = includes;
+    pp->macros = macros;
+    moc->knownQObjectClasses = knownQObjectClasses;
+    moc->knownGadgets = knownGadgets;
+    moc->metaTypes = metaTypes;
+    moc->interface2IdMap = interface2IdMap;
+    return true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,61 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef MOCSTATE_H
+#define MOCSTATE_H
+
+#include <qbytearray.h>
+#include <qstring.h>
+
+QT_BEGIN_NAMESPACE
+
+class Preprocessor;
+class Moc;
+
+/*
+    What preprocessing and parsing a prefix header leaves behind, for
+    --save-state and --load-state: the macros, the files included (later
+    #includes of them are skipped) and the QObject classes, gadgets,
+    metatypes and interfaces declared in them. Input files that start with
+    the same prelude then start where the prefix header ended, much like
+    with a precompiled header.
+
+    A state is stored with the fingerprint of the options it depends on
+    and the size and modification time of every file it was built from.
+    loadMocState() refuses it if any of them differ, and otherwise sets up
+    pp and moc, which must not have processed any input yet.
+*/
+bool saveMocState(const QString &path, const QByteArray &fingerprint, const Preprocessor &pp, const Moc &moc);
+bool loadMocState(const QString &path, const QByteArray &fingerprint, Preprocessor *pp, Moc *moc,
+                  QByteArray *errorString);
+
+QT_END_NAMESPACE
+
+#endif // MOCSTATE_H
@@ -0,0 +1,242 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "outputbuffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+QT_BEGIN_NAMESPACE
+
+// writes the digits of value backwards so that they end at end, returns
+// the first digit
+static char *formatDigits(char *end, uint value, uint base)
+{
+    static const char digits[] = "0123456789abcdef";
+    do {
+        *--end = digits[value % base];
+        value /= base;
+    } while (value);
+    return end;
+}
+
+static void appendFill(QByteArray &buffer, int count, char c)
+{
+    const int size = buffer.size();
+    buffer.resize(size + count);
+    memset(buffer.data() + size, c, count);
+}
+
+void OutputBuffer::writeNumber(int value, int width)
+{
+    char digits[16];
+    char *end = digits + sizeof(digits);
+    char *begin = formatDigits(end, value < 0 ? 0u - uint(value) : uint(value), 10);
+    if (value < 0)
+        *--begin = '-';
+    const int len = int(end - begin);
+    if (len < width)
+        appendFill(buffer, width - len, ' ');
+    buffer.append(begin, len);
+}
+
+void OutputBuffer::print(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vprint(format, ap);
+    va_end(ap);
+}
+
+void OutputBuffer::vprint(const char *format, va_list ap)
+{
+    const char *p = format;
+    for (;;) {
+        const char *percent = strchr(p, '%');
+        if (!percent) {
+            buffer.append(p);
+            break;
+        }
+        buffer.append(p, int(percent - p));
+        p = percent + 1;
+        if (*p == '%') {
+            buffer.append('%');
+            ++p;
+            continue;
+        }
+
+        bool leftAlign = false;
+        bool zeroPad = false;
+        for (;; ++p) {
+            if (*p == '-')
+                leftAlign = true;
+            else if (*p == '0')
+                zeroPad = true;
+            else
+                break;
+        }
+        int width = 0;
+        if (*p == '*') {
+            ++p;
+            width = va_arg(ap, int);
+            if (width < 0) {
+                leftAlign = true;
+                width = -width;
+            }
+        } else {
+            while (*p >= '0' && *p <= '9')
+                width = width * 10 + *p++ - '0';
+        }
+        int precision = -1;
+        if (*p == '.') {
+            ++p;
+            if (*p == '*') {
+                ++p;
+                precision = qMax(-1, va_arg(ap, int));
+            } else {
+                precision = 0;
+                while (*p >= '0' && *p <= '9')
+                    precision = precision * 10 + *p++ - '0';
+            }
+        }
+
+        char digits[16];
+        char *end = digits + sizeof(digits);
+        const char *str = end;
+        int len = 0;
+        char sign = 0;
+        bool isNumber = true;
+        uint value = 0;
+        uint base = 10;
+        switch (*p++) {
+        case 'd':
+        case 'i': {
+            const int v = va_arg(ap, int);
+            if (v < 0)
+                sign = '-';
+            value = v < 0 ? 0u - uint(v) : uint(v);
+            break;
+        }
+        case 'u':
+            value = va_arg(ap, uint);
+            break;
+        case 'x':
+            value = va_arg(ap, uint);
+            base = 16;
+            break;
+        case 'c':
+            digits[0] = char(va_arg(ap, int));
+            str = digits;
+            len = 1;
+            isNumber = false;
+            break;
+        case 's':
+            str = va_arg(ap, const char *);
+            if (!str)
+                str = "(null)";
+            if (precision < 0) {
+                len = int(strlen(str));
+            } else {
+                while (len < precision && str[len])
+                    ++len;
+            }
+            isNumber = false;
+            break;
+        default:
+            // the argument cannot be skipped without knowing its type, and
+            // all later ones would be read wrongly
+            qFatal("OutputBuffer::print: unsupported conversion in \"%s\"", format);
+        }
+
+        int zeros = 0;
+        if (isNumber) {
+            if (value || precision) {
+                str = formatDigits(end, value, base);
+                len = int(end - str);
+            }
+            if (precision >= 0)
+                zeros = qMax(0, precision - len);
+            else if (zeroPad && !leftAlign)
+                zeros = qMax(0, width - len - (sign ? 1 : 0));
+        }
+        const int padding = width - len - zeros - (sign ? 1 : 0);
+        if (padding > 0 && !leftAlign)
+            appendFill(buffer, padding, ' ');
+        if (sign)
+            buffer.append(sign);
+        if (zeros)
+            appendFill(buffer, zeros, '0');
+        buffer.append(str, len);
+        if (padding > 0 && leftAlign)
+            appendFill(buffer, padding, ' ');
+    }
+}
+
+static thread_local RequestOutput *requestOutput = 0;
+
+RequestOutput *currentRequestOutput()
+{
+    return requestOutput;
+}
+
+void setCurrentRequestOutput(RequestOutput *output)
+{
+    requestOutput = output;
+}
+
+void printMessage(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    if (requestOutput)
+        requestOutput->err.vprint(format, ap);
+    else
+        vfprintf(stderr, format, ap);
+    va_end(ap);
+}
+
+void writeStandardOutput(const QByteArray &data)
+{
+    if (requestOutput)
+        requestOutput->out.write(data);
+    else
+        fwrite(data.constData(), 1, data.size(), stdout);
+}
+
+void exitMoc(int code)
+{
+    if (requestOutput) {
+        const RequestExit requestExit = { code };
+        throw requestExit;
+    }
+    exit(code);
+}
+
+QT_END_NAMESPACE
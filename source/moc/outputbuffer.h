@@ -0,0 +1,97 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef OUTPUTBUFFER_H
+#define OUTPUTBUFFER_H
+
+#include <qbytearray.h>
+#include <stdarg.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Collects the generated code in memory, so that it can be written
+    with a single write once generation has finished. print() accepts
+    the printf conversions moc uses (d, u, x, s and c with flags '-' and
+    '0', width and precision); it formats them itself instead of going
+    through stdio. Any other conversion is a fatal error.
+*/
+class OutputBuffer
+{
+public:
+    OutputBuffer() { buffer.reserve(16384); }
+
+    void print(const char *format, ...) Q_ATTRIBUTE_FORMAT_PRINTF(2, 3);
+    void vprint(const char *format, va_list ap);
+
+    void write(char c) { buffer.append(c); }
+    void write(const char *str) { buffer.append(str); }
+    void write(const char *str, int len) { buffer.append(str, len); }
+    void write(const QByteArray &str) { buffer.append(str); }
+    // like print("%*d", width, value)
+    void writeNumber(int value, int width = 0);
+
+    const QByteArray &data() const { return buffer; }
+    int size() const { return buffer.size(); }
+
+private:
+    QByteArray buffer;
+};
+
+/*
+    What moc writes to stdout and stderr. The moc server sets a
+    RequestOutput for the thread that runs a request, so both are
+    collected for the client, and a fatal error ends the request by
+    throwing RequestExit instead of ending the process.
+*/
+struct RequestOutput
+{
+    OutputBuffer out;
+    OutputBuffer err;
+};
+
+struct RequestExit
+{
+    int code;
+};
+
+// 0 unless the calling thread runs a server request
+RequestOutput *currentRequestOutput();
+void setCurrentRequestOutput(RequestOutput *output);
+
+// to stderr or the request's err
+void printMessage(const char *format, ...) Q_ATTRIBUTE_FORMAT_PRINTF(1, 2);
+// to stdout or the request's out
+void writeStandardOutput(const QByteArray &data);
+Q_NORETURN void exitMoc(int code);
+
+QT_END_NAMESPACE
+
+#endif // OUTPUTBUFFER_H
@@ -33,13 +33,14 @@
 
 #include "parser.h"
 #include "utils.h"
+#include "outputbuffer.h"
 #include <stdio.h>
 #include <stdlib.h>
 
 QT_BEGIN_NAMESPACE
 
 #ifdef USE_LEXEM_STORE
-Symbol::LexemStore Symbol::lexemStore;
+thread_local Symbol::LexemStore Symbol::lexemStore;
 #endif
 
 static const char *error_msg = 0;
@@ -50,30 +51,37 @@ static const char *error_msg = 0;
 #define ErrorFormatString "%s:%d: "
 #endif
 
-void Parser::error(int rollback) {
+template <typename Container>
+void BasicParser<Container>::error(int rollback) {
     index -= rollback;
     error();
 }
-void Parser::error(const char *msg) {
+template <typename Container>
+void BasicParser<Container>::error(const char *msg) {
     if (msg || error_msg)
-        fprintf(stderr, ErrorFormatString "Error: %s\n",
+        printMessage(ErrorFormatString "Error: %s\n",
                  currentFilenames.top().constData(), symbol().lineNum, msg?msg:error_msg);
     else
-        fprintf(stderr, ErrorFormatString "Parse error at \"%s\"\n",
+        printMessage(ErrorFormatString "Parse error at \"%s\"\n",
                  currentFilenames.top().constData(), symbol().lineNum, symbol().lexem().data());
-    exit(EXIT_FAILURE);
+    exitMoc(EXIT_FAILURE);
 }
 
-void Parser::warning(const char *msg) {
+template <typename Container>
+void BasicParser<Container>::warning(const char *msg) {
     if (displayWarnings && msg)
-        fprintf(stderr, ErrorFormatString "Warning: %s\n",
+        printMessage(ErrorFormatString "Warning: %s\n",
                 currentFilenames.top().constData(), qMax(0, index > 0 ? symbol().lineNum : 0), msg);
 }
 
-void Parser::note(const char *msg) {
+template <typename Container>
+void BasicParser<Container>::note(const char *msg) {
     if (displayNotes && msg)
-        fprintf(stderr, ErrorFormatString "Note: %s\n",
+        printMessage(ErrorFormatString "Note: %s\n",
                 currentFilenames.top().constData(), qMax(0, index > 0 ? symbol().lineNum : 0), msg);
 }
 
+template class BasicParser<Symbols>;
+template class BasicParser<TokenBuffer>;
+
 QT_END_NAMESPACE
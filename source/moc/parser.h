@@ -36,41 +36,59 @@
 
 #include <qstack.h>
 #include "symbols.h"
+#include "tokenbuffer.h"
 
 QT_BEGIN_NAMESPACE
 
-class Parser
+inline Token tokenAt(const Symbols &symbols, int i) { return symbols.at(i).token; }
+inline Token tokenAt(const TokenBuffer &symbols, int i) { return symbols.tokenAt(i); }
+inline QByteArray lexemAt(const Symbols &symbols, int i) { return symbols.at(i).lexem(); }
+inline QByteArray lexemAt(const TokenBuffer &symbols, int i) { return symbols.lexemAt(i); }
+inline LexemView lexemViewAt(const Symbols &symbols, int i) { return symbols.at(i).lexemView(); }
+inline LexemView lexemViewAt(const TokenBuffer &symbols, int i) { return symbols.lexemViewAt(i); }
+
+// shared by all parser types, the include paths are passed on from the preprocessor to moc
+struct ParserIncludePath
+{
+    inline explicit ParserIncludePath(const QByteArray &_path)
+        : path(_path), isFrameworkPath(false) {}
+    QByteArray path;
+    bool isFrameworkPath;
+};
+
+// Parser is used by the preprocessor, which rewrites its token stream;
+// moc parses the compact TokenBuffer
+template <typename Container>
+class BasicParser
 {
 public:
-    Parser():index(0), displayWarnings(true), displayNotes(true) {}
-    Symbols symbols;
+    typedef typename Container::const_reference SymbolReference;
+
+    BasicParser():index(0), displayWarnings(true), displayNotes(true) {}
+    Container symbols;
     int index;
     bool displayWarnings;
     bool displayNotes;
 
-    struct IncludePath
-    {
-        inline explicit IncludePath(const QByteArray &_path)
-            : path(_path), isFrameworkPath(false) {}
-        QByteArray path;
-        bool isFrameworkPath;
-    };
+    typedef ParserIncludePath IncludePath;
     QList<IncludePath> includes;
 
     QStack<QByteArray> currentFilenames;
 
     inline bool hasNext() const { return (index < symbols.size()); }
-    inline Token next() { if (index >= symbols.size()) return NOTOKEN; return symbols.at(index++).token; }
+    inline Token next() { if (index >= symbols.size()) return NOTOKEN; return tokenAt(symbols, index++); }
     bool test(Token);
     void next(Token);
     void next(Token, const char *msg);
     inline void prev() {--index;}
     inline Token lookup(int k = 1);
-    inline const Symbol &symbol_lookup(int k = 1) { return symbols.at(index-1+k);}
-    inline Token token() { return symbols.at(index-1).token;}
-    inline QByteArray lexem() { return symbols.at(index-1).lexem();}
+    inline SymbolReference symbol_lookup(int k = 1) { return symbols.at(index-1+k);}
+    inline Token token() { return tokenAt(symbols, index-1);}
+    inline QByteArray lexem() { return lexemAt(symbols, index-1);}
     inline QByteArray unquotedLexem() { return symbols.at(index-1).unquotedLexem();}
-    inline const Symbol &symbol() { return symbols.at(index-1);}
+    // valid while symbols is unchanged
+    inline LexemView lexemView() const { return lexemViewAt(symbols, index-1); }
+    inline SymbolReference symbol() { return symbols.at(index-1);}
 
     void error(int rollback);
     void error(const char *msg = 0);
@@ -79,28 +97,34 @@ public:
 
 };
 
-inline bool Parser::test(Token token)
+typedef BasicParser<Symbols> Parser;
+
+template <typename Container>
+inline bool BasicParser<Container>::test(Token token)
 {
-    if (index < symbols.size() && symbols.at(index).token == token) {
+    if (index < symbols.size() && tokenAt(symbols, index) == token) {
         ++index;
         return true;
     }
     return false;
 }
 
-inline Token Parser::lookup(int k)
+template <typename Container>
+inline Token BasicParser<Container>::lookup(int k)
 {
     const int l = index - 1 + k;
-    return l < symbols.size() ? symbols.at(l).token : NOTOKEN;
+    return l < symbols.size() ? tokenAt(symbols, l) : NOTOKEN;
 }
 
-inline void Parser::next(Token token)
+template <typename Container>
+inline void BasicParser<Container>::next(Token token)
 {
     if (!test(token))
         error();
 }
 
-inline void Parser::next(Token token, const char *msg)
+template <typename Container>
+inline void BasicParser<Container>::next(Token token, const char *msg)
 {
     if (!test(token))
         error(msg);
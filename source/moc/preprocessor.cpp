@@ -38,6 +38,10 @@
 #include <qfile.h>
 #include <qdir.h>
 #include <qfileinfo.h>
+#include <qcryptographichash.h>
+#include <qdatastream.h>
+#include <qdatetime.h>
+#include <qsavefile.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -47,8 +51,9 @@ QT_BEGIN_NAMESPACE
 // transform \r\n into \n
 // \r into \n (os9 style)
 // backslash-newlines into newlines
-static QByteArray cleaned(const QByteArray &input)
+static QByteArray cleaned(const QByteArray &input, TimeReport *timeReport)
 {
+    PhaseTimer timer(timeReport, TimeReport::Clean);
     QByteArray result;
     result.resize(input.size());
     const char *data = input.constData();
@@ -109,52 +114,69 @@ static QByteArray cleaned(const QByteArray &input)
         }
     }
     result.resize(output - result.constData());
+    timer.addBytes(result.size());
     return result;
 }
 
-bool Preprocessor::preprocessOnly = false;
-void Preprocessor::skipUntilEndif()
+ConditionalJumps Preprocessor::indexConditionals(const Symbols &symbols)
 {
-    while(index < symbols.size() - 1 && symbols.at(index).token != PP_ENDIF){
-        switch (symbols.at(index).token) {
+    ConditionalJumps jumps(symbols.size(), -1);
+    QVector<int> open; // the current branch of every open conditional
+    for (int i = 0; i < symbols.size(); ++i) {
+        switch (symbols.at(i).token) {
         case PP_IF:
         case PP_IFDEF:
         case PP_IFNDEF:
-            ++index;
-            skipUntilEndif();
+        case PP_ELIF:
+            if (symbols.at(i).token == PP_ELIF && !open.isEmpty())
+                jumps[open.last()] = i;
+            else
+                open.append(i);
+            open.last() = i;
+            // directives in the condition do not count
+            while (i < symbols.size() - 1 && symbols.at(i + 1).token != PP_NEWLINE)
+                ++i;
+            break;
+        case PP_ELSE:
+            if (!open.isEmpty())
+                jumps[open.last()] = i;
+            else
+                open.append(i);
+            open.last() = i;
+            break;
+        case PP_ENDIF:
+            // a stray #endif is ignored
+            if (!open.isEmpty())
+                jumps[open.takeLast()] = i;
             break;
         default:
-            ;
+            break;
         }
-        ++index;
     }
+    // an unterminated conditional swallows the rest of the file, and the
+    // end of file symbol as well if a nested conditional is unterminated too
+    for (int i = 0; i < open.size(); ++i)
+        jumps[open.at(i)] = i == open.size() - 1 ? symbols.size() - 1 : symbols.size();
+    return jumps;
 }
 
-bool Preprocessor::skipBranch()
+void Preprocessor::skipUntilEndif(int directive)
 {
-    while (index < symbols.size() - 1
-          && (symbols.at(index).token != PP_ENDIF
-               && symbols.at(index).token != PP_ELIF
-               && symbols.at(index).token != PP_ELSE)
-       ){
-        switch (symbols.at(index).token) {
-        case PP_IF:
-        case PP_IFDEF:
-        case PP_IFNDEF:
-            ++index;
-            skipUntilEndif();
-            break;
-        default:
-            ;
-        }
-        ++index;
-    }
+    index = directive;
+    while (index < symbols.size() - 1 && symbols.at(index).token != PP_ENDIF)
+        index = conditionalJumps.at(index);
+}
+
+bool Preprocessor::skipBranch(int directive)
+{
+    index = conditionalJumps.at(directive);
     return (index < symbols.size() - 1);
 }
 
 
-Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocessor::TokenizeMode mode)
+Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocessor::TokenizeMode mode) const
 {
+    PhaseTimer timer(timeReport, TimeReport::Tokenize);
     Symbols symbols;
     const char *begin = input.constData();
     const char *data = begin;
@@ -183,7 +205,6 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
                 ++data;
             }
 
-            // suboptimal, is_ident_char  should use a table
             if (keywords[state].ident && is_ident_char(*data))
                 token = keywords[state].ident;
 
@@ -193,7 +214,7 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
                 // an error really, but let's ignore this input
                 // to not confuse moc later. However in pre-processor
                 // only mode let's continue.
-                if (!Preprocessor::preprocessOnly)
+                if (!preprocessOnly)
                     continue;
             }
 
@@ -206,7 +227,7 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
                     token = STRING_LITERAL;
                     // concatenate multi-line strings for easier
                     // STRING_LITERAL handling in moc
-                    if (!Preprocessor::preprocessOnly
+                    if (!preprocessOnly
                         && !symbols.isEmpty()
                         && symbols.last().token == STRING_LITERAL) {
 
@@ -268,8 +289,7 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
                 case HASH:
                     if (column == 1 && mode == TokenizeCpp) {
                         mode = PreparePreprocessorStatement;
-                        while (*data && (*data == ' ' || *data == '\t'))
-                            ++data;
+                        data = skip_spaces(data);
                         if (is_ident_char(*data))
                             mode = TokenizePreprocessorStatement;
                         continue;
@@ -290,8 +310,7 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
                 case BACKSLASH:
                 {
                     const char *rewind = data;
-                    while (*data && (*data == ' ' || *data == '\t'))
-                        ++data;
+                    data = skip_spaces(data);
                     if (*data && *data == '\n') {
                         ++data;
                         continue;
@@ -299,46 +318,29 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
                     data = rewind;
                 } break;
                 case CHARACTER:
-                    while (is_ident_char(*data))
-                        ++data;
+                    data = skip_ident_chars(data);
                     token = IDENTIFIER;
                     break;
                 case C_COMMENT:
-                    if (*data) {
-                        if (*data == '\n')
-                            ++lineNum;
-                        ++data;
-                        if (*data) {
-                            if (*data == '\n')
-                                ++lineNum;
-                            ++data;
-                        }
-                    }
-                    while (*data && (*(data-1) != '/' || *(data-2) != '*')) {
-                        if (*data == '\n')
-                            ++lineNum;
-                        ++data;
-                    }
+                    data = skipCComment(data, &lineNum);
                     token = WHITESPACE; // one comment, one whitespace
-                    // fall through;
+                    // fall through
                 case WHITESPACE:
                     if (column == 1)
                         column = 0;
-                    while (*data && (*data == ' ' || *data == '\t'))
-                        ++data;
-                    if (Preprocessor::preprocessOnly) // tokenize whitespace
+                    data = skip_spaces(data);
+                    if (preprocessOnly) // tokenize whitespace
                         break;
                     continue;
                 case CPP_COMMENT:
-                    while (*data && *data != '\n')
-                        ++data;
+                    data = find_char(data, '\n', '\n');
                     continue; // ignore safely, the newline is a separator
                 default:
                     continue; //ignore
                 }
             }
 #ifdef USE_LEXEM_STORE
-            if (!Preprocessor::preprocessOnly
+            if (!preprocessOnly
                 && token != IDENTIFIER
                 && token != STRING_LITERAL
                 && token != FLOATING_LITERAL
@@ -374,7 +376,6 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
                 token = pp_keywords[state].token;
                 ++data;
             }
-            // suboptimal, is_ident_char  should use a table
             if (pp_keywords[state].ident && is_ident_char(*data))
                 token = pp_keywords[state].ident;
 
@@ -449,8 +450,7 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
                     mode = TokenizePreprocessorStatement;
                     continue;
                 }
-                while (is_ident_char(*data))
-                    ++data;
+                data = skip_ident_chars(data);
                 token = PP_IDENTIFIER;
 
                 if (mode == PrepareDefine) {
@@ -465,30 +465,14 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
                 }
                 break;
             case PP_C_COMMENT:
-                if (*data) {
-                    if (*data == '\n')
-                        ++lineNum;
-                    ++data;
-                    if (*data) {
-                        if (*data == '\n')
-                            ++lineNum;
-                        ++data;
-                    }
-                }
-                while (*data && (*(data-1) != '/' || *(data-2) != '*')) {
-                    if (*data == '\n')
-                        ++lineNum;
-                    ++data;
-                }
+                data = skipCComment(data, &lineNum);
                 token = PP_WHITESPACE; // one comment, one whitespace
-                // fall through;
+                // fall through
             case PP_WHITESPACE:
-                while (*data && (*data == ' ' || *data == '\t'))
-                    ++data;
+                data = skip_spaces(data);
                 continue; // the preprocessor needs no whitespace
             case PP_CPP_COMMENT:
-                while (*data && *data != '\n')
-                    ++data;
+                data = find_char(data, '\n', '\n');
                 continue; // ignore safely, the newline is a separator
             case PP_NEWLINE:
                 ++lineNum;
@@ -497,8 +481,7 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
             case PP_BACKSLASH:
             {
                 const char *rewind = data;
-                while (*data && (*data == ' ' || *data == '\t'))
-                    ++data;
+                data = skip_spaces(data);
                 if (*data && *data == '\n') {
                     ++data;
                     continue;
@@ -529,11 +512,44 @@ Symbols Preprocessor::tokenize(const QByteArray& input, int lineNum, Preprocesso
         }
     }
     symbols += Symbol(); // eof symbol
+    timer.addTokens(symbols.size());
     return symbols;
 }
 
+Macro &MacroTable::operator[](const MacroName &name)
+{
+    int i = id(name);
+    if (i < 0) {
+#ifdef USE_LEXEM_STORE
+        const QByteArray key = name;
+#else
+        // copy the name, the key must not keep the whole source file alive
+        const QByteArray key(name.array.constData() + name.from, name.len);
+#endif
+        i = names.size();
+        ids.insert(key, i);
+        names.append(key);
+        macros.append(Macro());
+        defined.resize(i + 1);
+    }
+    if (!defined.testBit(i)) {
+        defined.setBit(i);
+        macros[i] = Macro();
+    }
+    return macros[i];
+}
+
+void MacroTable::remove(const MacroName &name)
+{
+    const int i = id(name);
+    if (i < 0)
+        return;
+    defined.clearBit(i);
+    macros[i] = Macro();
+}
+
 void Preprocessor::macroExpand(Symbols *into, Preprocessor *that, const Symbols &toExpand, int &index,
-                                  int lineNum, bool one, const QSet<QByteArray> &excludeSymbols)
+                                  int lineNum, bool one, const MacroIdSet &excludeSymbols)
 {
     SymbolStack symbols;
     SafeSymbols sf;
@@ -546,15 +562,17 @@ void Preprocessor::macroExpand(Symbols *into, Preprocessor *that, const Symbols
         return;
 
     for (;;) {
-        QByteArray macro;
+        int macro = -1;
         Symbols newSyms = macroExpandIdentifier(that, symbols, lineNum, &macro);
 
-        if (macro.isEmpty()) {
+        if (macro < 0) {
             // not a macro
             Symbol s = symbols.symbol();
             s.lineNum = lineNum;
             *into += s;
         } else {
+            if (that->timeReport)
+                ++that->timeReport->macroExpansions;
             SafeSymbols sf;
             sf.symbols = newSyms;
             sf.index = 0;
@@ -573,17 +591,18 @@ void Preprocessor::macroExpand(Symbols *into, Preprocessor *that, const Symbols
 }
 
 
-Symbols Preprocessor::macroExpandIdentifier(Preprocessor *that, SymbolStack &symbols, int lineNum, QByteArray *macroName)
+Symbols Preprocessor::macroExpandIdentifier(Preprocessor *that, SymbolStack &symbols, int lineNum, int *macroId)
 {
     Symbol s = symbols.symbol();
 
     // not a macro
-    if (s.token != PP_IDENTIFIER || !that->macros.contains(s) || symbols.dontReplaceSymbol(s.lexem())) {
+    const int id = s.token == PP_IDENTIFIER ? that->macros.id(s) : -1;
+    if (!that->macros.isDefined(id) || symbols.dontReplaceSymbol(id)) {
         return Symbols();
     }
 
-    const Macro &macro = that->macros.value(s);
-    *macroName = s.lexem();
+    const Macro &macro = that->macros.macro(id);
+    *macroId = id;
 
     Symbols expansion;
     if (!macro.isFunction) {
@@ -592,7 +611,7 @@ Symbols Preprocessor::macroExpandIdentifier(Preprocessor *that, SymbolStack &sym
         bool haveSpace = false;
         while (symbols.test(PP_WHITESPACE)) { haveSpace = true; }
         if (!symbols.test(PP_LPAREN)) {
-            *macroName = QByteArray();
+            *macroId = -1;
             Symbols syms;
             if (haveSpace)
                 syms += Symbol(lineNum, PP_WHITESPACE);
@@ -672,7 +691,7 @@ Symbols Preprocessor::macroExpandIdentifier(Preprocessor *that, SymbolStack &sym
                 const Symbols &arg = arguments.at(index);
                 QByteArray stringified;
                 for (int i = 0; i < arg.size(); ++i) {
-                    stringified += arg.at(i).lexem();
+                    stringified += arg.at(i).lexemView();
                 }
                 stringified.replace('"', "\\\"");
                 stringified.prepend('"');
@@ -970,15 +989,19 @@ int Preprocessor::evaluateCondition()
     return expression.value();
 }
 
-static QByteArray readOrMapFile(QFile *file)
+static QByteArray readOrMapFile(QFile *file, TimeReport *timeReport)
 {
+    PhaseTimer timer(timeReport, TimeReport::ReadFile);
     const qint64 size = file->size();
     char *rawInput = reinterpret_cast<char*>(file->map(0, size));
-    return rawInput ? QByteArray::fromRawData(rawInput, size) : file->readAll();
+    const QByteArray input = rawInput ? QByteArray::fromRawData(rawInput, size) : file->readAll();
+    timer.addBytes(input.size());
+    return input;
 }
 
-static void mergeStringLiterals(Symbols *_symbols)
+static void mergeStringLiterals(Symbols *_symbols, TimeReport *timeReport)
 {
+    PhaseTimer timer(timeReport, TimeReport::MergeStringLiterals);
     Symbols &symbols = *_symbols;
     for (Symbols::iterator i = symbols.begin(); i != symbols.end(); ++i) {
         if (i->token == STRING_LITERAL) {
@@ -1005,13 +1028,307 @@ static void mergeStringLiterals(Symbols *_symbols)
                 break;
         }
     }
+    timer.addTokens(symbols.size());
+}
+
+enum IncludeEntryType { NoEntry, FileEntry, DirEntry };
+
+static QByteArray includeCandidate(const QByteArray &dir, const QByteArray &include)
+{
+    if (QDir::isAbsolutePath(QString::fromLocal8Bit(include.constData())))
+        return include;
+    return dir + '/' + include;
+}
+
+static QByteArray entryKey(const QString &name)
+{
+#if defined(Q_OS_WIN) || defined(Q_OS_MAC)
+    return name.toLower().toLocal8Bit(); // case insensitive file systems
+#else
+    return name.toLocal8Bit();
+#endif
+}
+
+static qint64 directoryTime(const QByteArray &dir)
+{
+    const QFileInfo fi(QString::fromLocal8Bit(dir.constData()));
+    return fi.exists() ? fi.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+void PreprocessorCache::dropChangedDirectories()
+{
+    QMutexLocker locker(&mutex);
+    bool changed = false;
+    QHash<QByteArray, qint64>::iterator it = directoryTimes.begin();
+    while (it != directoryTimes.end()) {
+        if (directoryTime(it.key()) != it.value()) {
+            directoryListings.remove(it.key());
+            it = directoryTimes.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+    if (changed)
+        resolvedIncludes.clear();
+}
+
+/*
+    Returns what path refers to. With a cache this is answered from a
+    listing of the directory containing path, so looking up many includes
+    in the same include directory only reads that directory once.
+ */
+static IncludeEntryType includeEntryType(PreprocessorCache *cache, const QByteArray &path)
+{
+    if (!cache) {
+        const QFileInfo fi(QString::fromLocal8Bit(path.constData()));
+        return fi.exists() ? (fi.isDir() ? DirEntry : FileEntry) : NoEntry;
+    }
+
+    int slash = path.lastIndexOf('/');
+#ifdef Q_OS_WIN
+    slash = qMax(slash, path.lastIndexOf('\\'));
+#endif
+    QByteArray dir = slash < 0 ? QByteArray(".") : path.left(slash);
+    if (slash >= 0 && (dir.isEmpty() || dir.endsWith(':'))) // root directory
+        dir = path.left(slash + 1);
+    const QByteArray name = path.mid(slash + 1);
+
+    QHash<QByteArray, QHash<QByteArray, bool> >::iterator it = cache->directoryListings.find(dir);
+    if (it == cache->directoryListings.end()) {
+        QHash<QByteArray, bool> listing;
+        cache->directoryTimes.insert(dir, directoryTime(dir));
+        const QDir directory(QString::fromLocal8Bit(dir.constData()));
+        foreach (const QString &entry, directory.entryList(QDir::Files | QDir::Hidden))
+            listing.insert(entryKey(entry), false);
+        foreach (const QString &entry, directory.entryList(QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot))
+            listing.insert(entryKey(entry), true);
+        cache->fileSystemCalls += 3;
+        it = cache->directoryListings.insert(dir, listing);
+    }
+    QHash<QByteArray, bool>::const_iterator entry = it->constFind(entryKey(QString::fromLocal8Bit(name.constData())));
+    if (entry == it->constEnd())
+        return NoEntry;
+    return entry.value() ? DirEntry : FileEntry;
+}
+
+QByteArray Preprocessor::resolveInclude(const QByteArray &include, bool local, const QByteArray &relativeTo)
+{
+    QMutexLocker locker(cache ? &cache->mutex : 0);
+    QByteArray cacheKey;
+    if (cache) {
+        if (local)
+            cacheKey = QFileInfo(QString::fromLocal8Bit(relativeTo.constData())).path().toLocal8Bit();
+        cacheKey += '\n';
+        cacheKey += include;
+        QHash<QByteArray, PreprocessorCache::ResolvedInclude>::const_iterator it = cache->resolvedIncludes.constFind(cacheKey);
+        if (it != cache->resolvedIncludes.constEnd()) {
+            cache->fileSystemCallsSaved += it->fileSystemCalls;
+            return it->path;
+        }
+    }
+
+    // a lookup without cache checks each candidate once and canonicalizes the result
+    int uncachedCalls = 0;
+    const int callsBefore = cache ? cache->fileSystemCalls : 0;
+
+    QByteArray candidate;
+    IncludeEntryType type = NoEntry;
+    if (local) {
+        candidate = includeCandidate(QFileInfo(QString::fromLocal8Bit(relativeTo.constData())).path().toLocal8Bit(), include);
+        type = includeEntryType(cache, candidate);
+        ++uncachedCalls;
+    }
+    for (int j = 0; j < Preprocessor::includes.size() && type == NoEntry; ++j) {
+        const IncludePath &p = Preprocessor::includes.at(j);
+        if (p.isFrameworkPath) {
+            const int slashPos = include.indexOf('/');
+            if (slashPos == -1)
+                continue;
+            QByteArray frameworkCandidate = include.left(slashPos);
+            frameworkCandidate.append(".framework/Headers/");
+            candidate = includeCandidate(p.path + '/' + frameworkCandidate, include.mid(slashPos + 1));
+        } else {
+            candidate = includeCandidate(p.path, include);
+        }
+        type = includeEntryType(cache, candidate);
+        ++uncachedCalls;
+        // try again, maybe there's a file later in the include paths with the same name
+        // (186067)
+        if (type == DirEntry)
+            type = NoEntry;
+    }
+
+    QByteArray resolved;
+    if (type == FileEntry) {
+        resolved = QFileInfo(QString::fromLocal8Bit(candidate.constData())).canonicalFilePath().toLocal8Bit();
+        ++uncachedCalls;
+        if (cache)
+            ++cache->fileSystemCalls;
+    }
+    if (cache) {
+        const PreprocessorCache::ResolvedInclude entry = { resolved, uncachedCalls };
+        cache->resolvedIncludes.insert(cacheKey, entry);
+        cache->fileSystemCallsSaved += uncachedCalls - (cache->fileSystemCalls - callsBefore);
+    }
+    return resolved;
+}
+
+// bump when the tokenizer output changes
+static const char tokenCacheFormat[] = "moc-tokens 1 " QT_VERSION_STR;
+
+static QString tokenCachePath(const QString &directory, const QByteArray &filename)
+{
+    const QByteArray hash = QCryptographicHash::hash(filename, QCryptographicHash::Sha1).toHex();
+    return directory + QLatin1Char('/') + QString::fromLatin1(hash.constData()) + QLatin1String(".tokens");
+}
+
+/*
+    Serialized token stream: a header identifying the file and the
+    tokenizer, the cleaned input and the symbols. Lexems that are part of
+    the input are stored as offsets into it, so the loaded symbols share
+    one buffer just like freshly tokenized ones.
+ */
+static bool readTokenCache(const QString &path, const QByteArray &filename, bool preprocessOnly,
+                           qint64 size, qint64 lastModified, Symbols *symbols)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    QByteArray format, storedName;
+    qint64 storedSize, storedLastModified;
+    bool storedPreprocessOnly;
+    stream >> format >> storedName >> storedSize >> storedLastModified >> storedPreprocessOnly;
+    if (stream.status() != QDataStream::Ok || format != tokenCacheFormat || storedName != filename
+        || storedSize != size || storedLastModified != lastModified || storedPreprocessOnly != preprocessOnly)
+        return false;
+
+    QByteArray input;
+    qint32 count;
+    stream >> input >> count;
+    if (stream.status() != QDataStream::Ok || count < 0)
+        return false;
+    Symbols result;
+    // a damaged count must not make us allocate more than the file holds;
+    // each symbol takes at least two qint32, a bool and an empty lexem
+    result.reserve(int(qMin<qint64>(count, file.bytesAvailable() / 13)));
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 lineNum, token;
+        bool inInput;
+        stream >> lineNum >> token >> inInput;
+        if (inInput) {
+            qint32 from, len;
+            stream >> from >> len;
+            if (from < 0 || len < 0 || from > input.size() || len > input.size() - from)
+                return false;
+            result += Symbol(lineNum, Token(token), input, from, len);
+        } else {
+            QByteArray lexem;
+            stream >> lexem;
+            result += Symbol(lineNum, Token(token), lexem, 0, lexem.size());
+        }
+    }
+    if (stream.status() != QDataStream::Ok)
+        return false;
+    *symbols = result;
+    return true;
+}
+
+static void writeTokenCache(const QString &path, const QByteArray &filename, bool preprocessOnly,
+                            qint64 size, qint64 lastModified, const QByteArray &input, const Symbols &symbols)
+{
+    QDir().mkpath(QFileInfo(path).path());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << QByteArray(tokenCacheFormat) << filename << size << lastModified << preprocessOnly;
+    stream << input << qint32(symbols.size());
+    foreach (const Symbol &sym, symbols) {
+        stream << qint32(sym.lineNum) << qint32(sym.token);
+        const QByteArray lexem = sym.lexem();
+#ifdef USE_LEXEM_STORE
+        const int from = -1; // interned lexems do not point into the input
+#else
+        const int from = sym.from;
+#endif
+        const bool inInput = from >= 0 && from + lexem.size() <= input.size()
+                && memcmp(input.constData() + from, lexem.constData(), lexem.size()) == 0;
+        stream << inInput;
+        if (inInput)
+            stream << qint32(from) << qint32(lexem.size());
+        else
+            stream << lexem;
+    }
+    file.commit();
+}
+
+Symbols Preprocessor::tokenizeFile(const QByteArray &filename, ConditionalJumps *conditionalJumps)
+{
+    const QFileInfo fi(QString::fromLocal8Bit(filename.constData()));
+    const qint64 size = fi.size();
+    const qint64 lastModified = fi.lastModified().toMSecsSinceEpoch();
+
+    QString diskCachePath;
+    if (cache) {
+        {
+            QMutexLocker locker(&cache->mutex);
+            QHash<QByteArray, PreprocessorCache::TokenizedFile>::const_iterator it = cache->tokenizedFiles.constFind(filename);
+            if (it != cache->tokenizedFiles.constEnd() && it->size == size && it->lastModified == lastModified) {
+                *conditionalJumps = it->conditionalJumps;
+                return it->symbols;
+            }
+            if (!cache->tokenCacheDirectory.isEmpty())
+                diskCachePath = tokenCachePath(cache->tokenCacheDirectory, filename);
+        }
+        Symbols stored;
+        if (!diskCachePath.isEmpty()
+            && readTokenCache(diskCachePath, filename, preprocessOnly, size, lastModified, &stored)) {
+            *conditionalJumps = indexConditionals(stored);
+            const PreprocessorCache::TokenizedFile entry = { size, lastModified, stored, *conditionalJumps };
+            QMutexLocker locker(&cache->mutex);
+            cache->tokenizedFiles.insert(filename, entry);
+            return stored;
+        }
+    }
+
+    Symbols result;
+    QFile file(QString::fromLocal8Bit(filename.constData()));
+    if (file.open(QFile::ReadOnly)) {
+        QByteArray input = readOrMapFile(&file, timeReport);
+        if (!input.isEmpty()) {
+            // phase 1: get rid of backslash-newlines
+            input = cleaned(input, timeReport);
+
+            // phase 2: tokenize for the preprocessor
+            result = tokenize(input);
+
+            if (!diskCachePath.isEmpty())
+                writeTokenCache(diskCachePath, filename, preprocessOnly, size, lastModified, input, result);
+        }
+    }
+    *conditionalJumps = indexConditionals(result);
+    if (cache) {
+        // another thread may have tokenized the file meanwhile, the result is the same
+        const PreprocessorCache::TokenizedFile entry = { size, lastModified, result, *conditionalJumps };
+        QMutexLocker locker(&cache->mutex);
+        cache->tokenizedFiles.insert(filename, entry);
+    }
+    return result;
 }
 
 void Preprocessor::preprocess(const QByteArray &filename, Symbols &preprocessed)
 {
     currentFilenames.push(filename);
-    preprocessed.reserve(preprocessed.size() + symbols.size());
+    if (!output)
+        preprocessed.reserve(preprocessed.size() + symbols.size());
     while (hasNext()) {
+        if (output && preprocessed.size() >= SymbolQueue::ChunkSize)
+            passOn(preprocessed, false);
         Token token = next();
 
         switch (token) {
@@ -1021,64 +1338,34 @@ void Preprocessor::preprocess(const QByteArray &filename, Symbols &preprocessed)
             QByteArray include;
             bool local = false;
             if (test(PP_STRING_LITERAL)) {
-                local = lexem().startsWith('\"');
+                local = lexemView().first() == '\"';
                 include = unquotedLexem();
             } else
                 continue;
             until(PP_NEWLINE);
 
-            // #### stringery
-            QFileInfo fi;
-            if (local)
-                fi.setFile(QFileInfo(QString::fromLocal8Bit(filename.constData())).dir(), QString::fromLocal8Bit(include.constData()));
-            for (int j = 0; j < Preprocessor::includes.size() && !fi.exists(); ++j) {
-                const IncludePath &p = Preprocessor::includes.at(j);
-                if (p.isFrameworkPath) {
-                    const int slashPos = include.indexOf('/');
-                    if (slashPos == -1)
-                        continue;
-                    QByteArray frameworkCandidate = include.left(slashPos);
-                    frameworkCandidate.append(".framework/Headers/");
-                    fi.setFile(QString::fromLocal8Bit(QByteArray(p.path + '/' + frameworkCandidate).constData()), QString::fromLocal8Bit(include.mid(slashPos + 1).constData()));
-                } else {
-                    fi.setFile(QString::fromLocal8Bit(p.path.constData()), QString::fromLocal8Bit(include.constData()));
-                }
-                // try again, maybe there's a file later in the include paths with the same name
-                // (186067)
-                if (fi.isDir()) {
-                    fi = QFileInfo();
-                    continue;
-                }
-            }
-
-            if (!fi.exists() || fi.isDir())
+            include = resolveInclude(include, local, filename);
+            if (include.isEmpty())
                 continue;
-            include = fi.canonicalFilePath().toLocal8Bit();
 
             if (Preprocessor::preprocessedIncludes.contains(include))
                 continue;
             Preprocessor::preprocessedIncludes.insert(include);
 
-            QFile file(QString::fromLocal8Bit(include.constData()));
-            if (!file.open(QFile::ReadOnly))
-                continue;
-
-            QByteArray input = readOrMapFile(&file);
-
-            file.close();
-            if (input.isEmpty())
+            QElapsedTimer includeTimer;
+            if (timeReport)
+                includeTimer.start();
+            ConditionalJumps includedJumps;
+            Symbols includedSymbols = tokenizeFile(include, &includedJumps);
+            if (includedSymbols.isEmpty())
                 continue;
 
             Symbols saveSymbols = symbols;
+            ConditionalJumps saveJumps = conditionalJumps;
             int saveIndex = index;
 
-            // phase 1: get rid of backslash-newlines
-            input = cleaned(input);
-
-            // phase 2: tokenize for the preprocessor
-            symbols = tokenize(input);
-            input.clear();
-
+            symbols = includedSymbols;
+            conditionalJumps = includedJumps;
             index = 0;
 
             // phase 3: preprocess conditions and substitute macros
@@ -1086,7 +1373,15 @@ void Preprocessor::preprocess(const QByteArray &filename, Symbols &preprocessed)
             preprocess(include, preprocessed);
             preprocessed += Symbol(lineNum, MOC_INCLUDE_END, include);
 
+            if (timeReport) {
+                TimeReport::IncludeStats &stats = timeReport->includes[include];
+                stats.nsecs += includeTimer.nsecsElapsed();
+                ++stats.inclusions;
+                stats.tokens += symbols.size();
+            }
+
             symbols = saveSymbols;
+            conditionalJumps = saveJumps;
             index = saveIndex;
             continue;
         }
@@ -1159,10 +1454,12 @@ void Preprocessor::preprocess(const QByteArray &filename, Symbols &preprocessed)
             continue; // skip unknown preprocessor statement
         case PP_IFDEF:
         case PP_IFNDEF:
-        case PP_IF:
+        case PP_IF: {
+            int directive = index - 1;
             while (!evaluateCondition()) {
-                if (!skipBranch())
+                if (!skipBranch(directive))
                     break;
+                directive = index;
                 if (test(PP_ELIF)) {
                 } else {
                     until(PP_NEWLINE);
@@ -1170,9 +1467,10 @@ void Preprocessor::preprocess(const QByteArray &filename, Symbols &preprocessed)
                 }
             }
             continue;
+        }
         case PP_ELIF:
         case PP_ELSE:
-            skipUntilEndif();
+            skipUntilEndif(index - 1);
             // fall through
         case PP_ENDIF:
             until(PP_NEWLINE);
@@ -1199,16 +1497,17 @@ void Preprocessor::preprocess(const QByteArray &filename, Symbols &preprocessed)
 
 Symbols Preprocessor::preprocessed(const QByteArray &filename, QFile *file)
 {
-    QByteArray input = readOrMapFile(file);
+    QByteArray input = readOrMapFile(file, timeReport);
 
     if (input.isEmpty())
         return symbols;
 
     // phase 1: get rid of backslash-newlines
-    input = cleaned(input);
+    input = cleaned(input, timeReport);
 
     // phase 2: tokenize for the preprocessor
     symbols = tokenize(input);
+    conditionalJumps = indexConditionals(symbols);
 
 #if 0
     for (int j = 0; j < symbols.size(); ++j)
@@ -1220,8 +1519,15 @@ Symbols Preprocessor::preprocessed(const QByteArray &filename, QFile *file)
 
     // phase 3: preprocess conditions and substitute macros
     Symbols result;
-    preprocess(filename, result);
-    mergeStringLiterals(&result);
+    {
+        PhaseTimer timer(timeReport, TimeReport::Preprocess);
+        passedOn = 0;
+        preprocess(filename, result);
+        if (output)
+            passOn(result, true);
+        timer.addTokens(result.size() + passedOn);
+    }
+    mergeStringLiterals(&result, timeReport);
 
 #if 0
     for (int j = 0; j < result.size(); ++j)
@@ -1234,6 +1540,55 @@ Symbols Preprocessor::preprocessed(const QByteArray &filename, QFile *file)
     return result;
 }
 
+/*
+    Pushes the symbols preprocessed so far to output. Adjacent string
+    literals are merged first, so unless all are passed on, trailing
+    string literals stay for the next chunk.
+*/
+void Preprocessor::passOn(Symbols &preprocessed, bool all)
+{
+    int end = preprocessed.size();
+    while (!all && end > 0 && preprocessed.at(end - 1).token == STRING_LITERAL)
+        --end;
+    if (!end)
+        return;
+    const Symbols rest = preprocessed.mid(end);
+    preprocessed.resize(end);
+    mergeStringLiterals(&preprocessed, timeReport);
+    passedOn += preprocessed.size();
+    output->push(preprocessed);
+    preprocessed = rest;
+}
+
+void SymbolQueue::push(const Symbols &chunk)
+{
+    QMutexLocker locker(&mutex);
+    while (chunks.size() >= capacity && !closed)
+        notFull.wait(&mutex);
+    chunks.append(chunk);
+    notEmpty.wakeOne();
+}
+
+bool SymbolQueue::pop(Symbols *chunk)
+{
+    QMutexLocker locker(&mutex);
+    while (chunks.isEmpty() && !closed)
+        notEmpty.wait(&mutex);
+    if (chunks.isEmpty())
+        return false;
+    *chunk = chunks.takeFirst();
+    notFull.wakeOne();
+    return true;
+}
+
+void SymbolQueue::close()
+{
+    QMutexLocker locker(&mutex);
+    closed = true;
+    notEmpty.wakeAll();
+    notFull.wakeAll();
+}
+
 void Preprocessor::parseDefineArguments(Macro *m)
 {
     Symbols arguments;
@@ -1243,7 +1598,7 @@ void Preprocessor::parseDefineArguments(Macro *m)
         if (t == PP_RPAREN)
             break;
         if (t != PP_IDENTIFIER) {
-            QByteArray l = lexem();
+            const LexemView l = lexemView();
             if (l == "...") {
                 m->isVariadic = true;
                 arguments += Symbol(symbol().lineNum, PP_IDENTIFIER, "__VA_ARGS__");
@@ -1251,7 +1606,7 @@ void Preprocessor::parseDefineArguments(Macro *m)
                 if (!test(PP_RPAREN))
                     error("missing ')' in macro argument list");
                 break;
-            } else if (!is_identifier(l.constData(), l.length())) {
+            } else if (!is_identifier(l.data, l.size)) {
                 error("Unexpected character in macro argument list.");
             }
         }
@@ -1267,7 +1622,7 @@ void Preprocessor::parseDefineArguments(Macro *m)
             break;
         if (t == PP_COMMA)
             continue;
-        if (lexem() == "...") {
+        if (lexemView() == "...") {
             //GCC extension:    #define FOO(x, y...) x(y)
             // The last argument was already parsed. Just mark the macro as variadic.
             m->isVariadic = true;
@@ -35,8 +35,12 @@
 #define PREPROCESSOR_H
 
 #include "parser.h"
+#include "timereport.h"
+#include <qbitarray.h>
 #include <qlist.h>
+#include <qmutex.h>
 #include <qset.h>
+#include <qwaitcondition.h>
 #include <stdio.h>
 
 QT_BEGIN_NAMESPACE
@@ -55,39 +59,157 @@ typedef QByteArray MacroName;
 #else
 typedef SubArray MacroName;
 #endif
-typedef QHash<MacroName, Macro> Macros;
+
+/*
+    The macros known to a Preprocessor. Macro names are interned: each
+    name gets an id on its first definition, and stays with it across
+    #undef and redefinition. Macros are stored in a table indexed by id,
+    so the preprocessor hashes an identifier once to find its macro and
+    then tracks macros being expanded by id.
+*/
+class MacroTable
+{
+public:
+    // -1 if name was never defined
+    inline int id(const MacroName &name) const { return ids.value(name, -1); }
+    inline bool isDefined(int id) const { return id >= 0 && defined.testBit(id); }
+    inline const Macro &macro(int id) const { return macros.at(id); }
+    inline QByteArray name(int id) const { return names.at(id); }
+    inline int idCount() const { return names.size(); }
+
+    inline bool contains(const MacroName &name) const { return isDefined(id(name)); }
+    inline Macro value(const MacroName &name) const
+    { const int i = id(name); return isDefined(i) ? macros.at(i) : Macro(); }
+    Macro &operator[](const MacroName &name);
+    inline void insert(const MacroName &name, const Macro &macro) { (*this)[name] = macro; }
+    void remove(const MacroName &name);
+
+private:
+    QHash<MacroName, int> ids;
+    QVector<QByteArray> names;
+    QVector<Macro> macros;
+    QBitArray defined;
+};
 
 class QFile;
 
+// For each #if, #elif and #else of a tokenized file, the index of the
+// #elif, #else or #endif ending its branch, so that an inactive branch is
+// skipped in one step. -1 for all other symbols.
+typedef QVector<int> ConditionalJumps;
+
+// Include lookups and tokenized include files. Both only depend on the
+// include paths and the file contents, so one cache can be shared by the
+// Preprocessors of all inputs processed in a batch run. Access is
+// serialized by the mutex, the Preprocessors may run on different threads.
+struct PreprocessorCache
+{
+    struct TokenizedFile
+    {
+        qint64 size;
+        qint64 lastModified;
+        Symbols symbols; // empty if the file could not be read
+        ConditionalJumps conditionalJumps;
+    };
+
+    struct ResolvedInclude
+    {
+        QByteArray path; // canonical path, empty if not found
+        int fileSystemCalls; // calls a lookup without the cache would make
+    };
+
+    PreprocessorCache() : fileSystemCalls(0), fileSystemCallsSaved(0) {}
+
+    QMutex mutex;
+    // "<dir of the including file for "" includes>\n<include>" -> resolved include
+    QHash<QByteArray, ResolvedInclude> resolvedIncludes;
+    // directory -> entry name -> entry is a directory; empty for directories that do not exist
+    QHash<QByteArray, QHash<QByteArray, bool> > directoryListings;
+    // directory -> modification time before it was listed, -1 if it did not exist
+    QHash<QByteArray, qint64> directoryTimes;
+    int fileSystemCalls;
+    int fileSystemCallsSaved;
+    // canonical path -> tokens, valid while size and modification time match
+    QHash<QByteArray, TokenizedFile> tokenizedFiles;
+    // if set, tokenized files are also stored here and reused by later runs
+    QString tokenCacheDirectory;
+
+    // For a cache kept across runs: forgets the listings of directories
+    // modified since they were listed, and all resolved includes if there
+    // were any.
+    void dropChangedDirectories();
+};
+
+/*
+    Chunks of preprocessed symbols, passed from a Preprocessor running on
+    another thread to the code that builds the parser's TokenBuffer.
+    push() blocks while capacity chunks are waiting, so the preprocessor
+    stays only a few chunks ahead and the whole token stream never exists
+    as Symbols at once.
+*/
+class SymbolQueue
+{
+public:
+    enum { ChunkSize = 4096 };
+
+    explicit SymbolQueue(int capacity) : capacity(capacity), closed(false) {}
+
+    void push(const Symbols &chunk);
+    // false once the queue is closed and all chunks are taken
+    bool pop(Symbols *chunk);
+    void close();
+
+private:
+    QMutex mutex;
+    QWaitCondition notFull;
+    QWaitCondition notEmpty;
+    QList<Symbols> chunks;
+    int capacity;
+    bool closed;
+};
+
 class Preprocessor : public Parser
 {
 public:
-    Preprocessor(){}
-    static bool preprocessOnly;
+    Preprocessor() : preprocessOnly(false), cache(0), timeReport(0), output(0), passedOn(0) {}
+    bool preprocessOnly;
     QList<QByteArray> frameworks;
     QSet<QByteArray> preprocessedIncludes;
-    Macros macros;
+    MacroTable macros;
+    PreprocessorCache *cache;
+    // if set, the time spent in each phase is added here
+    TimeReport *timeReport;
+    // if set, preprocessed() passes its result on in chunks and returns nothing
+    SymbolQueue *output;
     Symbols preprocessed(const QByteArray &filename, QFile *device);
 
+    QByteArray resolveInclude(const QByteArray &include, bool local, const QByteArray &relativeTo);
+    Symbols tokenizeFile(const QByteArray &filename, ConditionalJumps *conditionalJumps);
+    static ConditionalJumps indexConditionals(const Symbols &symbols);
+
     void parseDefineArguments(Macro *m);
 
-    void skipUntilEndif();
-    bool skipBranch();
+    void skipUntilEndif(int directive);
+    bool skipBranch(int directive);
 
     void substituteUntilNewline(Symbols &substituted);
-    static Symbols macroExpandIdentifier(Preprocessor *that, SymbolStack &symbols, int lineNum, QByteArray *macroName);
+    static Symbols macroExpandIdentifier(Preprocessor *that, SymbolStack &symbols, int lineNum, int *macroId);
     static void macroExpand(Symbols *into, Preprocessor *that, const Symbols &toExpand, int &index, int lineNum, bool one,
-                               const QSet<QByteArray> &excludeSymbols = QSet<QByteArray>());
+                               const MacroIdSet &excludeSymbols = MacroIdSet());
 
     int evaluateCondition();
 
     enum TokenizeMode { TokenizeCpp, TokenizePreprocessor, PreparePreprocessorStatement, TokenizePreprocessorStatement, TokenizeInclude, PrepareDefine, TokenizeDefine };
-    static Symbols tokenize(const QByteArray &input, int lineNum = 1, TokenizeMode mode = TokenizeCpp);
+    Symbols tokenize(const QByteArray &input, int lineNum = 1, TokenizeMode mode = TokenizeCpp) const;
 
 private:
     void until(Token);
 
+    ConditionalJumps conditionalJumps; // of symbols
+    int passedOn; // symbols pushed to output
+
     void preprocess(const QByteArray &filename, Symbols &preprocessed);
+    void passOn(Symbols &preprocessed, bool all);
 };
 
 QT_END_NAMESPACE
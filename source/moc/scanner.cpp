@@ -0,0 +1,164 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "scanner.h"
+#include "utils.h"
+
+#include <qfile.h>
+#include <string.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Unlike the tokenizer, the scanner works on memory mapped files that
+    are not NUL terminated, so every search is bounded by end.
+*/
+
+// first 'Q', '/', '"' or '\'' in [data, end), or end
+static const char *findInteresting(const char *data, const char *end)
+{
+#ifdef MOC_USE_SSE2
+    while (end - data >= 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        __m128i found = _mm_cmpeq_epi8(v, _mm_set1_epi8('Q'));
+        found = _mm_or_si128(found, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+        found = _mm_or_si128(found, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        found = _mm_or_si128(found, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+        const uint mask = uint(_mm_movemask_epi8(found));
+        if (mask)
+            return data + count_trailing_zeros(mask);
+        data += 16;
+    }
+#endif
+    while (data < end && *data != 'Q' && *data != '/' && *data != '"' && *data != '\'')
+        ++data;
+    return data;
+}
+
+// data points behind the opening quote; returns the position behind the closing one
+static const char *skipLiteral(const char *data, const char *end, char quote)
+{
+    while (data < end) {
+        const char c = *data++;
+        if (c == quote || c == '\n')
+            break;
+        if (c == '\\' && data < end)
+            ++data; // escaped character, or a backslash-newline
+    }
+    return data;
+}
+
+// data points behind the opening //; a backslash-newline continues the comment
+static const char *skipLineComment(const char *data, const char *end)
+{
+    for (;;) {
+        const char *newline = static_cast<const char *>(memchr(data, '\n', end - data));
+        if (!newline)
+            return end;
+        const char *last = newline - 1; // at worst the second '/'
+        if (*last == '\r')
+            --last;
+        data = newline + 1;
+        if (*last != '\\')
+            return data;
+    }
+}
+
+// data points behind the opening /*
+static const char *skipBlockComment(const char *data, const char *end)
+{
+    while (data < end) {
+        const char *star = static_cast<const char *>(memchr(data, '*', end - data));
+        if (!star || star + 1 == end)
+            return end;
+        data = star + 1;
+        if (*data == '/')
+            return data + 1;
+    }
+    return data;
+}
+
+static bool matchesWord(const char *data, const char *end, const char *word, int length)
+{
+    return end - data >= length && memcmp(data, word, length) == 0
+        && (end - data == length || !is_ident_char(data[length]));
+}
+
+bool containsMetaObjectMacro(const char *data, qint64 size)
+{
+    const char *begin = data;
+    const char *end = data + size;
+    for (;;) {
+        data = findInteresting(data, end);
+        if (data == end)
+            return false;
+        const char c = *data++;
+        switch (c) {
+        case 'Q':
+            if (data - 1 > begin && is_ident_char(data[-2]))
+                break; // inside an identifier
+            if (matchesWord(data, end, "_OBJECT", 7)
+                || matchesWord(data, end, "_GADGET", 7)
+                || matchesWord(data, end, "_PLUGIN_METADATA", 16))
+                return true;
+            break;
+        case '/':
+            if (data < end && *data == '/')
+                data = skipLineComment(data + 1, end);
+            else if (data < end && *data == '*')
+                data = skipBlockComment(data + 1, end);
+            break;
+        default:
+            data = skipLiteral(data, end, c);
+            break;
+        }
+    }
+}
+
+bool scanFile(const QString &filename, bool *needsMoc)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const qint64 size = file.size();
+    if (size == 0) {
+        *needsMoc = false;
+        return true;
+    }
+    if (const uchar *mapped = file.map(0, size)) {
+        *needsMoc = containsMetaObjectMacro(reinterpret_cast<const char *>(mapped), size);
+        return true;
+    }
+    const QByteArray data = file.readAll();
+    *needsMoc = containsMetaObjectMacro(data.constData(), data.size());
+    return true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <qbytearray.h>
+#include <qstring.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Quick check whether moc has anything to do for a header, without
+    preprocessing it: does it contain Q_OBJECT, Q_GADGET or
+    Q_PLUGIN_METADATA outside of comments and string or character
+    literals? Conditionals are not evaluated, so a macro in a disabled
+    #if branch still counts. A meta object macro that is only reached
+    through another macro defined in a different file is not found.
+*/
+bool containsMetaObjectMacro(const char *data, qint64 size);
+
+// false if the file cannot be read
+bool scanFile(const QString &filename, bool *needsMoc);
+
+QT_END_NAMESPACE
+
+#endif // SCANNER_H
@@ -41,6 +41,7 @@
 #include <qvector.h>
 #include <qstack.h>
 #include <qdebug.h>
+#include <string.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -69,13 +70,55 @@ inline uint qHash(const SubArray &key)
     return qHash(QLatin1String(key.array.constData() + key.from, key.len));
 }
 
+/*
+    A lexem in the buffer it was tokenized into, without copying it out.
+    The buffer must outlive the view; the parsers use views to compare
+    and concatenate lexems, and only create a QByteArray for what they
+    keep.
+*/
+struct LexemView
+{
+    inline LexemView() : data(0), size(0) {}
+    // symbols without lexem have a negative length
+    inline LexemView(const char *data, int size) : data(data), size(qMax(size, 0)) {}
+    const char *data;
+    int size;
+
+    inline bool isEmpty() const { return !size; }
+    inline char first() const { return data[0]; }
+    inline char last() const { return data[size - 1]; }
+    inline LexemView unquoted() const { return LexemView(data + 1, size - 2); }
+    inline QByteArray toByteArray() const { return QByteArray(data, size); }
+
+    inline bool operator==(const LexemView &other) const
+    { return size == other.size && memcmp(data, other.data, size) == 0; }
+    inline bool operator!=(const LexemView &other) const { return !operator==(other); }
+    template <int N>
+    inline bool operator==(const char (&literal)[N]) const
+    { return size == N - 1 && memcmp(data, literal, N - 1) == 0; }
+    template <int N>
+    inline bool operator!=(const char (&literal)[N]) const { return !operator==(literal); }
+};
+Q_DECLARE_TYPEINFO(LexemView, Q_PRIMITIVE_TYPE);
+
+inline uint qHash(const LexemView &key)
+{
+    return qHash(QLatin1String(key.data, key.size));
+}
+
+inline QByteArray &operator+=(QByteArray &array, const LexemView &lexem)
+{
+    return array.append(lexem.data, lexem.size);
+}
+
 
 struct Symbol
 {
 
 #ifdef USE_LEXEM_STORE
     typedef QHash<SubArray, QHashDummyValue> LexemStore;
-    static LexemStore lexemStore;
+    // one store per thread, input files may be processed in parallel
+    static thread_local LexemStore lexemStore;
 
     inline Symbol() : lineNum(-1),token(NOTOKEN){}
     inline Symbol(int lineNum, Token token):
@@ -98,6 +141,7 @@ struct Symbol
     inline QByteArray unquotedLexem() const { return lex.mid(1, lex.length()-2); }
     inline QByteArray lexem() const { return lex; }
     inline operator QByteArray() const { return lex; }
+    inline LexemView lexemView() const { return LexemView(lex.constData(), lex.size()); }
     QByteArray lex;
 
 #else
@@ -113,6 +157,7 @@ struct Symbol
     Token token;
     inline QByteArray lexem() const { return lex.mid(from, len); }
     inline QByteArray unquotedLexem() const { return lex.mid(from+1, len-2); }
+    inline LexemView lexemView() const { return LexemView(lex.constData() + from, len); }
     inline operator SubArray() const { return SubArray(lex, from, len); }
     bool operator==(const Symbol& o) const
     {
@@ -127,10 +172,14 @@ Q_DECLARE_TYPEINFO(Symbol, Q_MOVABLE_TYPE);
 
 typedef QVector<Symbol> Symbols;
 
+// ids of macros, see MacroTable
+typedef QVector<int> MacroIdSet;
+
 struct SafeSymbols {
+    SafeSymbols() : expandedMacro(-1), index(0) {}
     Symbols symbols;
-    QByteArray expandedMacro;
-    QSet<QByteArray> excludedSymbols;
+    int expandedMacro;
+    MacroIdSet excludedSymbols;
     int index;
 };
 Q_DECLARE_TYPEINFO(SafeSymbols, Q_MOVABLE_TYPE);
@@ -156,8 +205,8 @@ public:
     inline QByteArray lexem() const { return symbol().lexem(); }
     inline QByteArray unquotedLexem() { return symbol().unquotedLexem(); }
 
-    bool dontReplaceSymbol(const QByteArray &name);
-    QSet<QByteArray> excludeSymbols();
+    bool dontReplaceSymbol(int macroId) const;
+    MacroIdSet excludeSymbols() const;
 };
 
 inline bool SymbolStack::test(Token token)
@@ -174,21 +223,26 @@ inline bool SymbolStack::test(Token token)
     return false;
 }
 
-inline bool SymbolStack::dontReplaceSymbol(const QByteArray &name)
+inline bool SymbolStack::dontReplaceSymbol(int macroId) const
 {
     for (int i = 0; i < size(); ++i) {
-        if (name == at(i).expandedMacro || at(i).excludedSymbols.contains(name))
+        if (macroId == at(i).expandedMacro || at(i).excludedSymbols.contains(macroId))
             return true;
     }
     return false;
 }
 
-inline QSet<QByteArray> SymbolStack::excludeSymbols()
+inline MacroIdSet SymbolStack::excludeSymbols() const
 {
-    QSet<QByteArray> set;
+    MacroIdSet set;
     for (int i = 0; i < size(); ++i) {
-        set << at(i).expandedMacro;
-        set += at(i).excludedSymbols;
+        const SafeSymbols &frame = at(i);
+        if (frame.expandedMacro >= 0 && !set.contains(frame.expandedMacro))
+            set += frame.expandedMacro;
+        for (int j = 0; j < frame.excludedSymbols.size(); ++j) {
+            if (!set.contains(frame.excludedSymbols.at(j)))
+                set += frame.excludedSymbols.at(j);
+        }
     }
     return set;
 }
@@ -0,0 +1,165 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "timereport.h"
+#include <qjsonarray.h>
+#include <qjsondocument.h>
+#include <qjsonobject.h>
+#include <qlist.h>
+#include <qpair.h>
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+static const char * const phaseNames[TimeReport::PhaseCount] = {
+    "read file", "clean", "tokenize", "preprocess", "merge literals", "parse", "generate"
+};
+
+static const char * const phaseKeys[TimeReport::PhaseCount] = {
+    "readFile", "clean", "tokenize", "preprocess", "mergeStringLiterals", "parse", "generate"
+};
+
+void TimeReport::merge(const TimeReport &other)
+{
+    for (int i = 0; i < PhaseCount; ++i) {
+        phases[i].nsecs += other.phases[i].nsecs;
+        phases[i].runs += other.phases[i].runs;
+        phases[i].bytes += other.phases[i].bytes;
+        phases[i].tokens += other.phases[i].tokens;
+    }
+    for (QHash<QByteArray, IncludeStats>::const_iterator it = other.includes.constBegin();
+         it != other.includes.constEnd(); ++it) {
+        IncludeStats &stats = includes[it.key()];
+        stats.nsecs += it->nsecs;
+        stats.inclusions += it->inclusions;
+        stats.tokens += it->tokens;
+    }
+    inputFiles += other.inputFiles;
+    macroExpansions += other.macroExpansions;
+    normalizedTypeHits += other.normalizedTypeHits;
+    normalizedTypeMisses += other.normalizedTypeMisses;
+}
+
+typedef QPair<QByteArray, TimeReport::IncludeStats> IncludeEntry;
+
+static bool slowerInclude(const IncludeEntry &a, const IncludeEntry &b)
+{
+    if (a.second.nsecs != b.second.nsecs)
+        return a.second.nsecs > b.second.nsecs;
+    return a.first < b.first;
+}
+
+static QList<IncludeEntry> includesByTime(const QHash<QByteArray, TimeReport::IncludeStats> &includes)
+{
+    QList<IncludeEntry> entries;
+    for (QHash<QByteArray, TimeReport::IncludeStats>::const_iterator it = includes.constBegin();
+         it != includes.constEnd(); ++it)
+        entries.append(qMakePair(it.key(), it.value()));
+    std::sort(entries.begin(), entries.end(), slowerInclude);
+    return entries;
+}
+
+QByteArray TimeReport::toText() const
+{
+    const int maxIncludes = 20;
+    QByteArray text;
+    char line[1024];
+
+    qsnprintf(line, sizeof(line), "moc: time report for %d input file(s)\n", inputFiles);
+    text += line;
+    qsnprintf(line, sizeof(line), "%-16s %8s %11s %12s %10s\n",
+              "phase", "runs", "time ms", "bytes", "tokens");
+    text += line;
+    for (int i = 0; i < PhaseCount; ++i) {
+        const PhaseStats &stats = phases[i];
+        qsnprintf(line, sizeof(line), "%-16s %8lld %11.3f %12lld %10lld\n",
+                  phaseNames[i], stats.runs, stats.nsecs / 1e6, stats.bytes, stats.tokens);
+        text += line;
+    }
+    qsnprintf(line, sizeof(line), "macro expansions: %lld\n", macroExpansions);
+    text += line;
+    const qint64 typeLookups = normalizedTypeHits + normalizedTypeMisses;
+    qsnprintf(line, sizeof(line), "normalized type cache: %lld hits, %lld misses (%.1f%% hits)\n",
+              normalizedTypeHits, normalizedTypeMisses, typeLookups ? 100.0 * normalizedTypeHits / typeLookups : 0.0);
+    text += line;
+
+    if (!includes.isEmpty()) {
+        qsnprintf(line, sizeof(line), "%d included file(s), slowest first (time includes nested includes):\n",
+                  includes.size());
+        text += line;
+        qsnprintf(line, sizeof(line), "%11s %10s %10s  %s\n", "time ms", "inclusions", "tokens", "file");
+        text += line;
+        const QList<IncludeEntry> entries = includesByTime(includes);
+        for (int i = 0; i < entries.size() && i < maxIncludes; ++i) {
+            const IncludeStats &stats = entries.at(i).second;
+            qsnprintf(line, sizeof(line), "%11.3f %10d %10lld  %s\n",
+                      stats.nsecs / 1e6, stats.inclusions, stats.tokens, entries.at(i).first.constData());
+            text += line;
+        }
+    }
+    return text;
+}
+
+QByteArray TimeReport::toJson() const
+{
+    QJsonObject report;
+    report.insert(QStringLiteral("inputFiles"), inputFiles);
+    report.insert(QStringLiteral("macroExpansions"), double(macroExpansions));
+    report.insert(QStringLiteral("normalizedTypeHits"), double(normalizedTypeHits));
+    report.insert(QStringLiteral("normalizedTypeMisses"), double(normalizedTypeMisses));
+
+    QJsonArray phaseArray;
+    for (int i = 0; i < PhaseCount; ++i) {
+        const PhaseStats &stats = phases[i];
+        QJsonObject phase;
+        phase.insert(QStringLiteral("name"), QLatin1String(phaseKeys[i]));
+        phase.insert(QStringLiteral("runs"), double(stats.runs));
+        phase.insert(QStringLiteral("nsecs"), double(stats.nsecs));
+        phase.insert(QStringLiteral("bytes"), double(stats.bytes));
+        phase.insert(QStringLiteral("tokens"), double(stats.tokens));
+        phaseArray.append(phase);
+    }
+    report.insert(QStringLiteral("phases"), phaseArray);
+
+    QJsonArray includeArray;
+    foreach (const IncludeEntry &entry, includesByTime(includes)) {
+        QJsonObject include;
+        include.insert(QStringLiteral("file"), QString::fromLocal8Bit(entry.first));
+        include.insert(QStringLiteral("nsecs"), double(entry.second.nsecs));
+        include.insert(QStringLiteral("inclusions"), entry.second.inclusions);
+        include.insert(QStringLiteral("tokens"), double(entry.second.tokens));
+        includeArray.append(include);
+    }
+    report.insert(QStringLiteral("includes"), includeArray);
+
+    return QJsonDocument(report).toJson();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef TIMEREPORT_H
+#define TIMEREPORT_H
+
+#include <qbytearray.h>
+#include <qelapsedtimer.h>
+#include <qhash.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Where moc spends its time, for --time-report. For each phase the
+    report sums the wall time, how often the phase ran, and the bytes or
+    tokens the phase produced. Phases nest: preprocessing includes reading,
+    cleaning and tokenizing the included files. In a batch run every
+    input file fills its own report, and the reports are merged once all
+    files are done.
+*/
+struct TimeReport
+{
+    enum Phase { ReadFile, Clean, Tokenize, Preprocess, MergeStringLiterals, Parse, Generate, PhaseCount };
+
+    struct PhaseStats
+    {
+        PhaseStats() : nsecs(0), runs(0), bytes(0), tokens(0) {}
+        qint64 nsecs;
+        qint64 runs;
+        qint64 bytes;
+        qint64 tokens;
+    };
+
+    // the time spent on an included file, including the files it includes
+    struct IncludeStats
+    {
+        IncludeStats() : nsecs(0), inclusions(0), tokens(0) {}
+        qint64 nsecs;
+        int inclusions;
+        qint64 tokens;
+    };
+
+    TimeReport() : inputFiles(0), macroExpansions(0), normalizedTypeHits(0), normalizedTypeMisses(0) {}
+
+    PhaseStats phases[PhaseCount];
+    // canonical path -> stats
+    QHash<QByteArray, IncludeStats> includes;
+    int inputFiles;
+    qint64 macroExpansions;
+    // lookups in the cache of normalized type names, see Moc::normalizedType()
+    qint64 normalizedTypeHits;
+    qint64 normalizedTypeMisses;
+
+    void merge(const TimeReport &other);
+    QByteArray toText() const;
+    QByteArray toJson() const;
+};
+
+// adds the time between construction and destruction to a phase of
+// report; does nothing if report is 0
+class PhaseTimer
+{
+public:
+    PhaseTimer(TimeReport *report, TimeReport::Phase phase)
+        : stats(report ? &report->phases[phase] : 0)
+    {
+        if (stats)
+            timer.start();
+    }
+    ~PhaseTimer()
+    {
+        if (stats) {
+            stats->nsecs += timer.nsecsElapsed();
+            ++stats->runs;
+        }
+    }
+
+    void addBytes(qint64 bytes) { if (stats) stats->bytes += bytes; }
+    void addTokens(qint64 tokens) { if (stats) stats->tokens += tokens; }
+
+private:
+    TimeReport::PhaseStats *stats;
+    QElapsedTimer timer;
+};
+
+QT_END_NAMESPACE
+
+#endif // TIMEREPORT_H
@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "tokenbuffer.h"
+
+QT_BEGIN_NAMESPACE
+
+static inline int lexemLength(const Symbol &sym)
+{
+#ifdef USE_LEXEM_STORE
+    return sym.lex.size();
+#else
+    return sym.len;
+#endif
+}
+
+TokenBuffer::TokenBuffer(const Symbols &symbols)
+    : lastLineNum(0)
+{
+    append(symbols);
+}
+
+void TokenBuffer::append(const Symbols &symbols)
+{
+    const int count = symbols.size();
+    // later chunks rely on the arrays growing geometrically
+    if (isEmpty()) {
+        int arenaSize = 0;
+        for (int i = 0; i < count; ++i)
+            arenaSize += qMax(lexemLength(symbols.at(i)), 0);
+        arena.reserve(arenaSize);
+        kinds.reserve(count);
+        offsets.reserve(count);
+        lengths.reserve(count);
+        lineDeltas.reserve(count);
+        lineCheckpoints.reserve(count / LineCheckpointInterval + 1);
+    }
+
+    for (int j = 0; j < count; ++j) {
+        const Symbol &sym = symbols.at(j);
+        const int i = kinds.size();
+        kinds.append(quint16(sym.token));
+        offsets.append(quint32(arena.size()));
+        lengths.append(lexemLength(sym));
+#ifdef USE_LEXEM_STORE
+        arena.append(sym.lex);
+#else
+        if (sym.len > 0)
+            arena.append(sym.lex.constData() + sym.from, sym.len);
+#endif
+
+        if (i % LineCheckpointInterval == 0) {
+            lineCheckpoints.append(sym.lineNum);
+            lineDeltas.append(0);
+        } else {
+            const int delta = sym.lineNum - lastLineNum;
+            if (delta > LineDeltaEscape && delta <= 127) {
+                lineDeltas.append(qint8(delta));
+            } else {
+                lineDeltas.append(qint8(LineDeltaEscape));
+                largeLineDeltas.insert(i, delta);
+            }
+        }
+        lastLineNum = sym.lineNum;
+    }
+}
+
+int TokenBuffer::lineNumAt(int i) const
+{
+    const int checkpoint = i / LineCheckpointInterval;
+    int line = lineCheckpoints.at(checkpoint);
+    for (int j = checkpoint * LineCheckpointInterval + 1; j <= i; ++j) {
+        const int delta = lineDeltas.at(j);
+        line += delta == LineDeltaEscape ? largeLineDeltas.value(j) : delta;
+    }
+    return line;
+}
+
+Symbols TokenBuffer::toSymbols() const
+{
+    Symbols symbols;
+    symbols.reserve(size());
+    for (int i = 0; i < size(); ++i)
+        symbols.append(at(i));
+    return symbols;
+}
+
+QT_END_NAMESPACE
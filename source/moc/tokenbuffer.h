@@ -0,0 +1,97 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef TOKENBUFFER_H
+#define TOKENBUFFER_H
+
+#include "symbols.h"
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Compact, read-only form of a token stream.
+
+    Instead of one Symbol (a QByteArray handle plus position and line) per
+    token, the token kinds, lexem offsets, lexem lengths and line numbers
+    are stored in separate arrays. All lexems are copied into one arena.
+    Line numbers are delta-encoded in one byte per token, with an absolute
+    line number at every LineCheckpointInterval-th token. Copying a
+    TokenBuffer copies a few implicitly shared arrays, independent of the
+    number of tokens.
+
+    at() creates a Symbol referring to the arena, for code that needs the
+    lexem; parsers that only look at token kinds use tokenAt(), and
+    lexemViewAt() gives the lexem without copying it.
+*/
+class TokenBuffer
+{
+public:
+    typedef Symbol const_reference;
+
+    TokenBuffer() : lastLineNum(0) {}
+    explicit TokenBuffer(const Symbols &symbols);
+
+    // for a token stream that arrives in chunks
+    void append(const Symbols &symbols);
+
+    inline int size() const { return kinds.size(); }
+    inline bool isEmpty() const { return kinds.isEmpty(); }
+
+    inline Token tokenAt(int i) const { return Token(kinds.at(i)); }
+    int lineNumAt(int i) const;
+    inline QByteArray lexemAt(int i) const
+    { return lengths.at(i) > 0 ? arena.mid(offsets.at(i), lengths.at(i)) : QByteArray(); }
+    inline LexemView lexemViewAt(int i) const
+    { return LexemView(arena.constData() + offsets.at(i), lengths.at(i)); }
+    inline Symbol at(int i) const
+    {
+        if (lengths.at(i) < 0)
+            return Symbol(lineNumAt(i), tokenAt(i));
+        return Symbol(lineNumAt(i), tokenAt(i), arena, offsets.at(i), lengths.at(i));
+    }
+
+    Symbols toSymbols() const;
+
+private:
+    enum { LineCheckpointInterval = 64, LineDeltaEscape = -128 };
+
+    QByteArray arena;
+    QVector<quint16> kinds;
+    QVector<quint32> offsets;
+    QVector<qint32> lengths; // -1 for symbols without lexem, as in Symbol
+    QVector<qint8> lineDeltas; // LineDeltaEscape: the delta is in largeLineDeltas
+    QVector<int> lineCheckpoints;
+    QHash<int, int> largeLineDeltas;
+    int lastLineNum;
+};
+
+QT_END_NAMESPACE
+
+#endif // TOKENBUFFER_H
@@ -36,33 +36,70 @@
 
 #include <QtCore/qglobal.h>
 
+// define MOC_NO_SIMD to build the tokenizer without SSE2
+#if !defined(MOC_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MOC_USE_SSE2
+#include <emmintrin.h>
+#ifdef Q_CC_MSVC
+#include <intrin.h>
+#endif
+#endif
+
 QT_BEGIN_NAMESPACE
 
+enum CharClass {
+    CharIdentStart = 0x01, // a-z A-Z _ $
+    CharIdent = 0x02,      // a-z A-Z 0-9 _ $
+    CharDigit = 0x04,
+    CharOctal = 0x08,
+    CharHex = 0x10,
+    CharSpace = 0x20,      // space and tab
+    CharWhitespace = 0x40  // space, tab and newline
+};
+
+// character classes indexed by byte value; non-ASCII bytes have none
+static const uchar char_class[256] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x60, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x16, 0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x03,
+    0x00, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+inline bool has_char_class(char s, uint charClass)
+{
+    return char_class[uchar(s)] & charClass;
+}
+
 inline bool is_whitespace(char s)
 {
-    return (s == ' ' || s == '\t' || s == '\n');
+    return has_char_class(s, CharWhitespace);
 }
 
 inline bool is_space(char s)
 {
-    return (s == ' ' || s == '\t');
+    return has_char_class(s, CharSpace);
 }
 
 inline bool is_ident_start(char s)
 {
-    return ((s >= 'a' && s <= 'z')
-            || (s >= 'A' && s <= 'Z')
-            || s == '_' || s == '$'
-       );
+    return has_char_class(s, CharIdentStart);
 }
 
 inline bool is_ident_char(char s)
 {
-    return ((s >= 'a' && s <= 'z')
-            || (s >= 'A' && s <= 'Z')
-            || (s >= '0' && s <= '9')
-            || s == '_' || s == '$'
-       );
+    return has_char_class(s, CharIdent);
 }
 
 inline bool is_identifier(const char *s, int len)
@@ -79,29 +116,147 @@ inline bool is_identifier(const char *s, int len)
 
 inline bool is_digit_char(char s)
 {
-    return (s >= '0' && s <= '9');
+    return has_char_class(s, CharDigit);
 }
 
 inline bool is_octal_char(char s)
 {
-    return (s >= '0' && s <= '7');
+    return has_char_class(s, CharOctal);
 }
 
 inline bool is_hex_char(char s)
 {
-    return ((s >= 'a' && s <= 'f')
-            || (s >= 'A' && s <= 'F')
-            || (s >= '0' && s <= '9')
-       );
+    return has_char_class(s, CharHex);
+}
+
+/*
+    Scanning helpers of the tokenizer. They work on NUL terminated input
+    and stop at the terminating NUL. The _scalar versions are the
+    reference implementations; where SSE2 is available the others look
+    at 16 bytes at a time. Loads never cross into the next page, so they
+    cannot fault even when reading past the terminating NUL.
+*/
+
+inline const char *skip_ident_chars_scalar(const char *data)
+{
+    while (is_ident_char(*data))
+        ++data;
+    return data;
+}
+
+inline const char *skip_spaces_scalar(const char *data)
+{
+    while (is_space(*data))
+        ++data;
+    return data;
+}
+
+// first occurrence of a or b, or the terminating NUL
+inline const char *find_char_scalar(const char *data, char a, char b)
+{
+    while (*data && *data != a && *data != b)
+        ++data;
+    return data;
+}
+
+#ifdef MOC_USE_SSE2
+
+inline bool can_load_16(const char *data)
+{
+    return (quintptr(data) & 4095) <= 4096 - 16;
+}
+
+inline uint count_trailing_zeros(uint v)
+{
+#ifdef Q_CC_MSVC
+    unsigned long result;
+    _BitScanForward(&result, v);
+    return result;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+inline __m128i in_range_16(__m128i v, char from, char to)
+{
+    // signed compares, bytes >= 0x80 are never in an ASCII range
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(char(from - 1))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(char(to + 1))));
+}
+
+inline const char *skip_ident_chars(const char *data)
+{
+    while (can_load_16(data)) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        __m128i ident = in_range_16(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        ident = _mm_or_si128(ident, in_range_16(v, '0', '9'));
+        ident = _mm_or_si128(ident, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        ident = _mm_or_si128(ident, _mm_cmpeq_epi8(v, _mm_set1_epi8('$')));
+        const uint mask = ~uint(_mm_movemask_epi8(ident)) & 0xffff;
+        if (mask)
+            return data + count_trailing_zeros(mask);
+        data += 16;
+    }
+    return skip_ident_chars_scalar(data);
+}
+
+inline const char *skip_spaces(const char *data)
+{
+    while (can_load_16(data)) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        const __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                           _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        const uint mask = ~uint(_mm_movemask_epi8(space)) & 0xffff;
+        if (mask)
+            return data + count_trailing_zeros(mask);
+        data += 16;
+    }
+    return skip_spaces_scalar(data);
+}
+
+inline const char *find_char(const char *data, char a, char b)
+{
+    while (can_load_16(data)) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        __m128i found = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+        found = _mm_or_si128(found, _mm_cmpeq_epi8(v, _mm_set1_epi8(a)));
+        found = _mm_or_si128(found, _mm_cmpeq_epi8(v, _mm_set1_epi8(b)));
+        const uint mask = uint(_mm_movemask_epi8(found));
+        if (mask)
+            return data + count_trailing_zeros(mask);
+        data += 16;
+    }
+    return find_char_scalar(data, a, b);
+}
+
+#else
+
+inline const char *skip_ident_chars(const char *data)
+{
+    return skip_ident_chars_scalar(data);
+}
+
+inline const char *skip_spaces(const char *data)
+{
+    return skip_spaces_scalar(data);
 }
 
+inline const char *find_char(const char *data, char a, char b)
+{
+    return find_char_scalar(data, a, b);
+}
+
+#endif
+
 inline const char *skipQuote(const char *data)
 {
-    while (*data && (*data != '\"')) {
-        if (*data == '\\') {
-            ++data;
-            if (!*data) break;
-        }
+    for (;;) {
+        data = find_char(data, '\"', '\\');
+        if (*data != '\\')
+            break;
+        ++data;
+        if (!*data)
+            break;
         ++data;
     }
 
@@ -110,6 +265,20 @@ inline const char *skipQuote(const char *data)
     return data;
 }
 
+// data points behind the opening /*; returns the position behind the closing */
+inline const char *skipCComment(const char *data, int *lineNum)
+{
+    for (;;) {
+        data = find_char(data, '*', '\n');
+        if (!*data)
+            return data;
+        if (*data++ == '\n')
+            ++*lineNum;
+        else if (*data == '/')
+            return data + 1;
+    }
+}
+
 QT_END_NAMESPACE
 
 #endif // UTILS_H
@@ -0,0 +1,519 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "preprocessor.h"
+#include "moc.h"
+#include "utils.h"
+#include "synthetic.h"
+
+#include <qcoreapplication.h>
+#include <qcommandlineoption.h>
+#include <qcommandlineparser.h>
+#include <qdir.h>
+#include <qelapsedtimer.h>
+#include <qfile.h>
+#include <qfileinfo.h>
+#include <stdio.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    mocbench measures the throughput of moc's processing stages and checks
+    that optimized code paths give the same results as the reference
+    implementations.
+
+    Inputs are header files or directories, which are searched recursively,
+    and synthetic headers written by writeSyntheticHeaders(). Code generation
+    is also measured on a single synthetic class, as real headers rarely
+    have enough methods to show how it scales.
+
+    The code generated for each input can be compared with a baseline
+    directory, to check that an optimization leaves the output unchanged.
+*/
+
+static void collectFiles(const QString &path, QStringList *files)
+{
+    const QFileInfo fi(path);
+    if (!fi.isDir()) {
+        files->append(path);
+        return;
+    }
+    const QDir dir(path);
+    foreach (const QString &entry, dir.entryList(QDir::Files, QDir::Name))
+        files->append(dir.filePath(entry));
+    foreach (const QString &entry, dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name))
+        collectFiles(dir.filePath(entry), files);
+}
+
+static qint64 totalSize(const QList<QByteArray> &inputs)
+{
+    qint64 size = 0;
+    foreach (const QByteArray &input, inputs)
+        size += input.size();
+    return size;
+}
+
+static double megabytesPerSecond(qint64 bytes, qint64 nsecs)
+{
+    return nsecs ? (bytes / (1024.0 * 1024.0)) / (nsecs / 1e9) : 0.0;
+}
+
+// the per-character predicates the character class table replaced
+static bool referenceIdentChar(int c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$';
+}
+
+static bool referenceIdentStart(int c)
+{
+    return referenceIdentChar(c) && !(c >= '0' && c <= '9');
+}
+
+static bool referenceHexChar(int c)
+{
+    return (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') || (c >= '0' && c <= '9');
+}
+
+/*
+    Compares the character class table with the predicates it replaced and
+    the (possibly SIMD) scanning helpers with their scalar versions, at
+    every position of every input. Returns the number of mismatches.
+*/
+static int verifyScanning(const QList<QByteArray> &inputs)
+{
+    int mismatches = 0;
+    for (int c = 0; c < 256; ++c) {
+        const char ch = char(c);
+        if (is_ident_char(ch) != referenceIdentChar(c)
+            || is_ident_start(ch) != referenceIdentStart(c)
+            || is_digit_char(ch) != (c >= '0' && c <= '9')
+            || is_octal_char(ch) != (c >= '0' && c <= '7')
+            || is_hex_char(ch) != referenceHexChar(c)
+            || is_space(ch) != (c == ' ' || c == '\t')
+            || is_whitespace(ch) != (c == ' ' || c == '\t' || c == '\n')) {
+            fprintf(stderr, "mocbench: character class mismatch for 0x%02x\n", c);
+            ++mismatches;
+        }
+    }
+
+    foreach (const QByteArray &input, inputs) {
+        const char *data = input.constData();
+        for (int i = 0; i <= input.size(); ++i) {
+            const char *p = data + i;
+            if (skip_ident_chars(p) != skip_ident_chars_scalar(p)
+                || skip_spaces(p) != skip_spaces_scalar(p)
+                || find_char(p, '\n', '\n') != find_char_scalar(p, '\n', '\n')
+                || find_char(p, '*', '\n') != find_char_scalar(p, '*', '\n')
+                || find_char(p, '\"', '\\') != find_char_scalar(p, '\"', '\\')) {
+                fprintf(stderr, "mocbench: scanning mismatch at offset %d\n", i);
+                ++mismatches;
+            }
+        }
+    }
+    return mismatches;
+}
+
+static void benchmarkScanning(const QList<QByteArray> &inputs, int repeat)
+{
+    const qint64 bytes = totalSize(inputs) * repeat;
+    QElapsedTimer timer;
+    int scalarLines = 0;
+    int lines = 0;
+
+    timer.start();
+    for (int r = 0; r < repeat; ++r) {
+        foreach (const QByteArray &input, inputs) {
+            for (const char *p = input.constData(); *(p = find_char_scalar(p, '\n', '\n')); ++p)
+                ++scalarLines;
+        }
+    }
+    const qint64 scalar = timer.nsecsElapsed();
+
+    timer.start();
+    for (int r = 0; r < repeat; ++r) {
+        foreach (const QByteArray &input, inputs) {
+            for (const char *p = input.constData(); *(p = find_char(p, '\n', '\n')); ++p)
+                ++lines;
+        }
+    }
+    const qint64 optimized = timer.nsecsElapsed();
+
+    printf("line scan:  scalar %8.1f MB/s, %s %8.1f MB/s (%d lines)\n",
+           megabytesPerSecond(bytes, scalar),
+#ifdef MOC_USE_SSE2
+           "sse2  ",
+#else
+           "scalar",
+#endif
+           megabytesPerSecond(bytes, optimized), lines / repeat);
+    if (lines != scalarLines)
+        fprintf(stderr, "mocbench: line counts differ (%d, %d)\n", scalarLines, lines);
+}
+
+static void benchmarkTokenizer(const QList<QByteArray> &inputs, int repeat)
+{
+    Preprocessor pp;
+    const qint64 bytes = totalSize(inputs) * repeat;
+    qint64 tokens = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int r = 0; r < repeat; ++r) {
+        foreach (const QByteArray &input, inputs)
+            tokens += pp.tokenize(input).size();
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    printf("tokenize:   %8.1f MB/s, %lld tokens in %.1f ms\n",
+           megabytesPerSecond(bytes, elapsed), tokens, elapsed / 1e6);
+}
+
+// the result of running moc on one input
+struct StageResult
+{
+    StageResult() : tokens(0), classes(0) {}
+    qint64 tokens;
+    int classes;
+    QByteArray generated;
+};
+
+/*
+    Runs the preprocessor, parser and generator on fileName, adding the
+    time spent in each to elapsed.
+*/
+static StageResult runStages(const QString &fileName, qint64 elapsed[3])
+{
+    StageResult result;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "mocbench: cannot read %s\n", qPrintable(fileName));
+        return result;
+    }
+
+    Preprocessor pp;
+    pp.macros["Q_MOC_RUN"];
+    pp.macros["__cplusplus"];
+    Moc moc;
+    moc.filename = QFile::encodeName(fileName);
+    moc.currentFilenames.push(moc.filename);
+
+    QElapsedTimer timer;
+    timer.start();
+    Symbols preprocessed = pp.preprocessed(moc.filename, &file);
+    elapsed[0] += timer.nsecsElapsed();
+    result.tokens = preprocessed.size();
+
+    timer.start();
+    moc.includes = pp.includes;
+    moc.symbols = TokenBuffer(preprocessed);
+    preprocessed.clear();
+    moc.parse();
+    elapsed[1] += timer.nsecsElapsed();
+    result.classes = moc.classList.size();
+
+    timer.start();
+    OutputBuffer out;
+    if (!moc.classList.isEmpty())
+        moc.generate(&out);
+    elapsed[2] += timer.nsecsElapsed();
+    result.generated = out.data();
+    return result;
+}
+
+// the file in the baseline directory that holds the code generated for an input file
+static QString baselineFileName(const QString &input)
+{
+    QString name = QDir::current().relativeFilePath(input);
+    name.replace(QLatin1Char('/'), QLatin1Char('_'));
+    name.replace(QLatin1Char('\\'), QLatin1Char('_'));
+    name.replace(QLatin1Char(':'), QLatin1Char('_'));
+    return name + QStringLiteral(".moc");
+}
+
+// prints the first line in which generated differs from baseline
+static void reportDifference(const QString &input, const QByteArray &baseline, const QByteArray &generated)
+{
+    const QList<QByteArray> expected = baseline.split('\n');
+    const QList<QByteArray> actual = generated.split('\n');
+    int line = 0;
+    while (line < expected.size() && line < actual.size() && expected.at(line) == actual.at(line))
+        ++line;
+    fprintf(stderr, "mocbench: %s: generated code differs from the baseline in line %d\n"
+                    "  baseline:  %s\n  generated: %s\n",
+            qPrintable(input), line + 1,
+            line < expected.size() ? expected.at(line).constData() : "<end of file>",
+            line < actual.size() ? actual.at(line).constData() : "<end of file>");
+}
+
+/*
+    Compares the code generated for each input with the file of the
+    baseline name in baselineDir, or writes these files if update is set.
+    Returns the number of inputs whose code differs or has no baseline.
+*/
+static int compareWithBaseline(const QStringList &inputs, const QStringList &baselineNames,
+                               const QList<QByteArray> &generated, const QString &baselineDir, bool update)
+{
+    const QDir dir(baselineDir);
+    if (update && !QDir().mkpath(baselineDir)) {
+        fprintf(stderr, "mocbench: cannot create %s\n", qPrintable(baselineDir));
+        return inputs.size();
+    }
+
+    int differences = 0;
+    for (int i = 0; i < inputs.size(); ++i) {
+        QFile file(dir.filePath(baselineNames.at(i)));
+        if (update) {
+            if (!file.open(QIODevice::WriteOnly) || file.write(generated.at(i)) != generated.at(i).size()) {
+                fprintf(stderr, "mocbench: cannot write %s\n", qPrintable(file.fileName()));
+                ++differences;
+            }
+        } else if (!file.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "mocbench: %s: no baseline %s\n", qPrintable(inputs.at(i)), qPrintable(file.fileName()));
+            ++differences;
+        } else {
+            const QByteArray baseline = file.readAll();
+            if (baseline != generated.at(i)) {
+                reportDifference(inputs.at(i), baseline, generated.at(i));
+                ++differences;
+            }
+        }
+    }
+    return differences;
+}
+
+/*
+    Runs moc on each input repeat times and prints the throughput of the
+    preprocessor, the parser and the generator. The input size counts
+    the input files, not the files they include. The code generated by
+    the first repetition is returned in generated.
+*/
+static void benchmarkStages(const QStringList &inputs, qint64 bytes, int repeat, QList<QByteArray> *generated)
+{
+    qint64 elapsed[3] = { 0, 0, 0 };
+    qint64 tokens = 0;
+    qint64 outputBytes = 0;
+    int classes = 0;
+    for (int r = 0; r < repeat; ++r) {
+        foreach (const QString &input, inputs) {
+            const StageResult result = runStages(input, elapsed);
+            if (r == 0) {
+                tokens += result.tokens;
+                classes += result.classes;
+                outputBytes += result.generated.size();
+                generated->append(result.generated);
+            }
+        }
+    }
+    printf("preprocess: %8.1f MB/s, %lld tokens, %.1f ms per run\n",
+           megabytesPerSecond(bytes * repeat, elapsed[0]), tokens, elapsed[0] / 1e6 / repeat);
+    printf("parse:      %8.1f Mtokens/s, %d classes, %.1f ms per run\n",
+           elapsed[1] ? tokens * repeat / (elapsed[1] / 1e3) : 0.0, classes, elapsed[1] / 1e6 / repeat);
+    printf("generate:   %8.1f MB/s, %lld bytes, %.1f ms per run\n",
+           megabytesPerSecond(outputBytes * repeat, elapsed[2]), outputBytes, elapsed[2] / 1e6 / repeat);
+}
+
+static int benchmarkGenerator(int methods, int repeat)
+{
+    const QString fileName = QDir::tempPath() + QStringLiteral("/mocbench_synthetic.h");
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(syntheticClass(methods)) < 0) {
+        fprintf(stderr, "mocbench: cannot write %s\n", qPrintable(fileName));
+        return 1;
+    }
+    file.close();
+    file.open(QIODevice::ReadOnly);
+
+    Preprocessor pp;
+    Moc moc;
+    moc.filename = QFile::encodeName(fileName);
+    moc.currentFilenames.push(moc.filename);
+    moc.symbols = TokenBuffer(pp.preprocessed(moc.filename, &file));
+    moc.parse();
+    file.close();
+    file.remove();
+
+    QElapsedTimer timer;
+    timer.start();
+    int size = 0;
+    for (int r = 0; r < repeat; ++r) {
+        OutputBuffer out;
+        Moc copy = moc; // generating modifies the class definitions
+        copy.generate(&out);
+        size = out.size();
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    printf("generate:   %d methods, %.2f ms per class, %d bytes\n",
+           methods, elapsed / 1e6 / repeat, size);
+    return 0;
+}
+
+int runMocBench(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Benchmarks the stages of moc on a set of headers."));
+    parser.addHelpOption();
+
+    QCommandLineOption repeatOption(QStringLiteral("repeat"));
+    repeatOption.setDescription(QStringLiteral("Process the inputs <n> times (default: 10)."));
+    repeatOption.setValueName(QStringLiteral("n"));
+    parser.addOption(repeatOption);
+
+    QCommandLineOption verifyOption(QStringLiteral("verify"));
+    verifyOption.setDescription(QStringLiteral("Check the optimized scanning code against the reference implementation."));
+    parser.addOption(verifyOption);
+
+    QCommandLineOption syntheticOption(QStringLiteral("synthetic-methods"));
+    syntheticOption.setDescription(QStringLiteral("Benchmark code generation for a class with <n> signals and slots."));
+    syntheticOption.setValueName(QStringLiteral("n"));
+    parser.addOption(syntheticOption);
+
+    QCommandLineOption syntheticClassesOption(QStringLiteral("synthetic-classes"));
+    syntheticClassesOption.setDescription(QStringLiteral("Add synthetic headers with <n> classes, nested includes and macros "
+                                                         "and inactive #if regions to the inputs."));
+    syntheticClassesOption.setValueName(QStringLiteral("n"));
+    parser.addOption(syntheticClassesOption);
+
+    QCommandLineOption baselineOption(QStringLiteral("baseline-dir"));
+    baselineOption.setDescription(QStringLiteral("Compare the code generated for each input with the one stored in <dir>."));
+    baselineOption.setValueName(QStringLiteral("dir"));
+    parser.addOption(baselineOption);
+
+    QCommandLineOption updateBaselineOption(QStringLiteral("update-baseline"));
+    updateBaselineOption.setDescription(QStringLiteral("Store the generated code in the --baseline-dir instead of comparing it."));
+    parser.addOption(updateBaselineOption);
+
+    parser.addPositionalArgument(QStringLiteral("[header-file|directory...]"),
+            QStringLiteral("Headers to process, directories are searched recursively."));
+    parser.process(app);
+
+    int repeat = 10;
+    if (parser.isSet(repeatOption)) {
+        bool ok;
+        repeat = parser.value(repeatOption).toInt(&ok);
+        if (!ok || repeat < 1) {
+            fprintf(stderr, "mocbench: invalid value for --repeat\n");
+            return 1;
+        }
+    }
+
+    int syntheticMethods = 0;
+    if (parser.isSet(syntheticOption)) {
+        bool ok;
+        syntheticMethods = parser.value(syntheticOption).toInt(&ok);
+        if (!ok || syntheticMethods < 1) {
+            fprintf(stderr, "mocbench: invalid value for --synthetic-methods\n");
+            return 1;
+        }
+    }
+
+    int syntheticClasses = 0;
+    if (parser.isSet(syntheticClassesOption)) {
+        bool ok;
+        syntheticClasses = parser.value(syntheticClassesOption).toInt(&ok);
+        if (!ok || syntheticClasses < 1) {
+            fprintf(stderr, "mocbench: invalid value for --synthetic-classes\n");
+            return 1;
+        }
+    }
+
+    const QString baselineDir = parser.value(baselineOption);
+    if (parser.isSet(updateBaselineOption) && baselineDir.isEmpty()) {
+        fprintf(stderr, "mocbench: --update-baseline needs --baseline-dir\n");
+        return 1;
+    }
+
+    QStringList files;
+    foreach (const QString &path, parser.positionalArguments())
+        collectFiles(path, &files);
+    QStringList baselineNames;
+    foreach (const QString &file, files)
+        baselineNames.append(baselineFileName(file));
+    if (syntheticClasses) {
+        const QStringList headers = writeSyntheticHeaders(QDir::tempPath() + QStringLiteral("/mocbench_synthetic"),
+                                                          syntheticClasses);
+        if (headers.isEmpty()) {
+            fprintf(stderr, "mocbench: cannot write the synthetic headers\n");
+            return 1;
+        }
+        files += headers;
+        foreach (const QString &header, headers)
+            baselineNames.append(QFileInfo(header).fileName() + QStringLiteral(".moc"));
+    }
+    if (files.isEmpty() && !syntheticMethods) {
+        fprintf(stderr, "mocbench: no input files\n");
+        parser.showHelp(1);
+    }
+
+    QList<QByteArray> inputs;
+    foreach (const QString &fileName, files) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "mocbench: cannot read %s\n", qPrintable(fileName));
+            return 1;
+        }
+        inputs.append(file.readAll());
+    }
+    printf("%d files, %.1f MB\n", inputs.size(), totalSize(inputs) / (1024.0 * 1024.0));
+
+    if (parser.isSet(verifyOption)) {
+        const int mismatches = verifyScanning(inputs);
+        printf("verify:     %s\n", mismatches ? "FAILED" : "ok");
+        if (mismatches)
+            return 1;
+    }
+
+    int result = 0;
+    if (!inputs.isEmpty()) {
+        benchmarkScanning(inputs, repeat);
+        benchmarkTokenizer(inputs, repeat);
+        QList<QByteArray> generated;
+        benchmarkStages(files, totalSize(inputs), repeat, &generated);
+        if (!baselineDir.isEmpty()) {
+            const bool update = parser.isSet(updateBaselineOption);
+            const int differences = compareWithBaseline(files, baselineNames, generated, baselineDir, update);
+            if (update)
+                printf("baseline:   %d files written to %s\n", files.size() - differences, qPrintable(baselineDir));
+            else
+                printf("baseline:   %s\n", differences ? "DIFFERENT" : "same");
+            if (differences)
+                result = 1;
+        }
+    }
+    if (syntheticMethods && benchmarkGenerator(syntheticMethods, repeat))
+        result = 1;
+    return result;
+}
+
+QT_END_NAMESPACE
+
+int main(int _argc, char **_argv)
+{
+    return QT_PREPEND_NAMESPACE(runMocBench)(_argc, _argv);
+}
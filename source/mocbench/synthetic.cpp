@@ -0,0 +1,210 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "synthetic.h"
+
+#include <qdir.h>
+#include <qfile.h>
+
+QT_BEGIN_NAMESPACE
+
+enum {
+    ClassesPerHeader = 4,
+    MethodsPerClass = 32,
+    IncludeChainLength = 32,
+    MacroDepth = 32,
+    InactiveBlocks = 8
+};
+
+static bool writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+// object-like and function-like macros that expand through MacroDepth levels
+static QByteArray macroHeader()
+{
+    QByteArray code = "#ifndef SYNTHETIC_MACROS_H\n#define SYNTHETIC_MACROS_H\n\n"
+                      "#define SYN_VALUE_0 1\n"
+                      "#define SYN_ARG_0(x) (x)\n";
+    for (int i = 1; i < MacroDepth; ++i) {
+        const QByteArray n = QByteArray::number(i);
+        const QByteArray previous = QByteArray::number(i - 1);
+        code += "#define SYN_VALUE_" + n + " (SYN_VALUE_" + previous + " + 1)\n";
+        code += "#define SYN_ARG_" + n + "(x) SYN_ARG_" + previous + "((x) + " + n + ")\n";
+    }
+    code += "#define SYN_CONCAT(a, b) a##b\n"
+            "#define SYN_MEMBER(type, name) type name() const; void SYN_CONCAT(set_, name)(type);\n"
+            "\n#endif\n";
+    return code;
+}
+
+// code the preprocessor skips, with conditionals nested in it
+static QByteArray inactiveRegion()
+{
+    QByteArray code = "#if SYN_VALUE_31 < 0\n";
+    for (int b = 0; b < InactiveBlocks; ++b) {
+        const QByteArray block = QByteArray::number(b);
+        code += "#ifdef SYN_NESTED_" + block + "\n";
+        for (int i = 0; i < 16; ++i) {
+            const QByteArray n = block + '_' + QByteArray::number(i);
+            code += "    void inactive" + n + "(const QString &text = \"#endif\", char c = '\\''); // #else\n";
+        }
+        code += "#else\n"
+                "    /* a comment with #endif in it\n"
+                "       that spans lines */\n"
+                "#endif\n";
+    }
+    code += "#elif defined(SYN_NOT_DEFINED) && SYN_ARG_15(1) > 0\n"
+            "    int alternative;\n"
+            "#endif\n\n";
+    return code;
+}
+
+// link i of the include chain, each link includes the next one
+static QByteArray chainHeader(int i)
+{
+    const QByteArray n = QByteArray::number(i);
+    QByteArray code = "#ifndef SYNTHETIC_CHAIN_" + n + "_H\n#define SYNTHETIC_CHAIN_" + n + "_H\n\n";
+    if (i == 0)
+        code += "#include \"synthetic_macros.h\"\n";
+    if (i + 1 < IncludeChainLength)
+        code += "#include \"synthetic_chain_" + QByteArray::number(i + 1) + ".h\"\n";
+    code += "\n#define SYN_CHAIN_" + n + " SYN_ARG_7(" + n + ")\n\n"
+            "struct SynChain" + n + "\n{\n"
+            "    Q_GADGET\n"
+            "    Q_PROPERTY(int value MEMBER value)\n"
+            "public:\n"
+            "    enum Kind { First, Second = SYN_VALUE_3 };\n"
+            "    Q_ENUM(Kind)\n"
+            "    int value;\n"
+            "};\n"
+            "Q_DECLARE_METATYPE(SynChain" + n + ")\n\n"
+            "inline int synChainValue" + n + "()\n{\n"
+            "    int sum = 0;\n"
+            "    for (int i = 0; i < SYN_CHAIN_" + n + "; ++i) {\n"
+            "        if (i % 2) { sum += i; } else { sum -= SYN_VALUE_7; }\n"
+            "    }\n"
+            "    return sum;\n"
+            "}\n"
+            "\n#endif\n";
+    return code;
+}
+
+static QByteArray objectClass(int c)
+{
+    const QByteArray name = "Class" + QByteArray::number(c);
+    QByteArray code = "class " + name + " : public QObject\n{\n"
+            "    Q_OBJECT\n"
+            "    Q_PROPERTY(int count READ count WRITE setCount NOTIFY countChanged)\n"
+            "    Q_PROPERTY(QString title READ title WRITE setTitle NOTIFY titleChanged)\n"
+            "    Q_PROPERTY(QList<int> values READ values CONSTANT)\n"
+            "    Q_PROPERTY(SynChain5 chain MEMBER m_chain)\n"
+            "    Q_CLASSINFO(\"Index\", \"" + QByteArray::number(c) + "\")\n"
+            "public:\n"
+            "    enum State { Idle, Running = SYN_VALUE_7, Done };\n"
+            "    Q_ENUM(State)\n"
+            "    enum Option { NoOption = 0x0, OptionA = 0x1, OptionB = 0x2 };\n"
+            "    Q_DECLARE_FLAGS(Options, Option)\n"
+            "    Q_FLAG(Options)\n\n"
+            "    explicit " + name + "(QObject *parent = 0);\n"
+            "    int count() const;\n"
+            "    void setCount(int count);\n"
+            "    QString title() const;\n"
+            "    void setTitle(const QString &title);\n"
+            "    QList<int> values() const;\n"
+            "    SYN_MEMBER(int, extra)\n"
+            "    Q_INVOKABLE int compute(int a, int b = SYN_ARG_15(0)) const;\n"
+            "    Q_INVOKABLE QVariantMap describe(const QStringList &keys) const;\n\n"
+            "signals:\n"
+            "    void countChanged(int count);\n"
+            "    void titleChanged(const QString &title);\n";
+    for (int i = 0; i < MethodsPerClass / 2; ++i) {
+        const QByteArray n = QByteArray::number(i);
+        code += "    void changed" + n + "(int value" + n + ", const QString &text = QString());\n";
+    }
+    code += "\npublic slots:\n";
+    for (int i = MethodsPerClass / 2; i < MethodsPerClass; ++i) {
+        const QByteArray n = QByteArray::number(i);
+        code += "    void update" + n + "(double value" + n + ", const QByteArray &data" + n + ");\n";
+    }
+    code += "    void reset();\n\n"
+            "private:\n"
+            "    int scaled(int x) const { return x * SYN_VALUE_15; }\n"
+            "    SynChain5 m_chain;\n"
+            "};\n\n";
+    return code;
+}
+
+QStringList writeSyntheticHeaders(const QString &dir, int classes)
+{
+    const QDir target(dir);
+    if (!QDir().mkpath(dir))
+        return QStringList();
+
+    bool ok = writeFile(target.filePath(QStringLiteral("synthetic_macros.h")), macroHeader());
+    for (int i = 0; i < IncludeChainLength; ++i)
+        ok = ok && writeFile(target.filePath(QStringLiteral("synthetic_chain_%1.h").arg(i)), chainHeader(i));
+
+    QStringList headers;
+    for (int first = 0; ok && first < classes; first += ClassesPerHeader) {
+        const QByteArray n = QByteArray::number(first / ClassesPerHeader);
+        QByteArray code = "#ifndef SYNTHETIC_CLASSES_" + n + "_H\n#define SYNTHETIC_CLASSES_" + n + "_H\n\n"
+                          "#include \"synthetic_chain_0.h\"\n\n";
+        code += inactiveRegion();
+        code += "namespace Synthetic {\n\n";
+        for (int c = first; c < qMin(first + ClassesPerHeader, classes); ++c)
+            code += objectClass(c);
+        code += "} // namespace Synthetic\n\n#endif\n";
+        const QString header = target.filePath(QStringLiteral("synthetic_classes_%1.h").arg(first / ClassesPerHeader));
+        ok = writeFile(header, code);
+        headers.append(header);
+    }
+    return ok ? headers : QStringList();
+}
+
+QByteArray syntheticClass(int methods)
+{
+    QByteArray code = "class Synthetic : public QObject\n{\n    Q_OBJECT\nsignals:\n";
+    for (int i = 0; i < methods / 2; ++i) {
+        const QByteArray n = QByteArray::number(i);
+        code += "    void signal" + n + "(int count" + n + ", const QString &text" + n + ");\n";
+    }
+    code += "public slots:\n";
+    for (int i = methods / 2; i < methods; ++i) {
+        const QByteArray n = QByteArray::number(i);
+        code += "    void slot" + n + "(double value" + n + ", const QByteArray &data" + n + ");\n";
+    }
+    code += "};\n";
+    return code;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <qbytearray.h>
+#include <qstringlist.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Writes a set of headers to dir that exercise each stage of moc:
+    classes with many signals, slots, properties and enums, a chain of
+    nested includes, deeply nested macros, and large inactive #if
+    regions. The content only depends on classes, so the generated code
+    can be compared with a stored baseline. Returns the headers to run
+    moc on, or an empty list if dir cannot be written.
+*/
+QStringList writeSyntheticHeaders(const QString &dir, int classes);
+
+// a QObject with the given number of signals and slots, each with two arguments
+QByteArray syntheticClass(int methods);
+
+QT_END_NAMESPACE
+
+#endif // SYNTHETIC_H